@@ -1,3 +1,12 @@
 INCLUDEPATH += $$PWD
-SOURCES += $$PWD/mlsdbserialisation.cpp
-HEADERS += $$PWD/mlsdbserialisation.h
+SOURCES += $$PWD/mlsdbserialisation.cpp \
+    $$PWD/mlsdbindexfile.cpp \
+    $$PWD/mlsdbshardmanifest.cpp \
+    $$PWD/mlsdbbloomfilter.cpp \
+    $$PWD/mlsdbareatable.cpp
+HEADERS += $$PWD/mlsdbserialisation.h \
+    $$PWD/mlsdbindexfile.h \
+    $$PWD/mlsdbshardmanifest.h \
+    $$PWD/mlsdbbloomfilter.h \
+    $$PWD/mlsdbareatable.h \
+    $$PWD/yandexpositionfeed.h
@@ -0,0 +1,134 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbareatable.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtDebug>
+
+bool MlsdbAreaTable::load(const QString &fileName)
+{
+    clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    in >> magic >> version;
+    if (magic != MLSDB_AREAS_MAGIC || version != MLSDB_AREAS_VERSION) {
+        qDebug() << "geoclue-mlsdb area table" << fileName << "format unknown:" << magic << version;
+        return false;
+    }
+
+    for (int level = 0; level < LevelCount && in.status() == QDataStream::Ok; ++level) {
+        quint32 count = 0;
+        in >> count;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            quint64 key = 0;
+            MlsdbAreaLocation location;
+            in >> key >> location.coords.lat >> location.coords.lon >> location.radius >> location.cellCount;
+            m_areas[level].insert(key, location);
+        }
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "geoclue-mlsdb area table" << fileName << "is truncated";
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool MlsdbAreaTable::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << quint32(MLSDB_AREAS_MAGIC) << qint32(MLSDB_AREAS_VERSION);
+    for (int level = 0; level < LevelCount; ++level) {
+        out << quint32(m_areas[level].size());
+        QHash<quint64, MlsdbAreaLocation>::const_iterator it = m_areas[level].constBegin();
+        for (; it != m_areas[level].constEnd(); ++it) {
+            out << it.key() << it.value().coords.lat << it.value().coords.lon
+                << it.value().radius << it.value().cellCount;
+        }
+    }
+    return file.commit();
+}
+
+bool MlsdbAreaTable::isEmpty() const
+{
+    for (int level = 0; level < LevelCount; ++level) {
+        if (!m_areas[level].isEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MlsdbAreaTable::clear()
+{
+    for (int level = 0; level < LevelCount; ++level) {
+        m_areas[level].clear();
+    }
+}
+
+void MlsdbAreaTable::insert(Level level, quint64 key, const MlsdbAreaLocation &location)
+{
+    m_areas[level].insert(key, location);
+}
+
+bool MlsdbAreaTable::lookup(const MlsdbUniqueCellId &uniqueCellId, MlsdbAreaLocation *location, Level *level) const
+{
+    for (int i = 0; i < LevelCount; ++i) {
+        QHash<quint64, MlsdbAreaLocation>::const_iterator it
+                = m_areas[i].constFind(areaKey(static_cast<Level>(i), uniqueCellId));
+        if (it != m_areas[i].constEnd()) {
+            *location = it.value();
+            *level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+quint64 MlsdbAreaTable::areaKey(Level level, const MlsdbUniqueCellId &uniqueCellId)
+{
+    switch (level) {
+    case LocationCodeLevel: {
+        const quint64 lte = uniqueCellId.cellType() == MLSDB_CELL_TYPE_LTE ? 1 : 0;
+        return lte << 63 | quint64(uniqueCellId.mcc()) << 48
+             | quint64(uniqueCellId.mnc()) << 32 | uniqueCellId.locationCode();
+    }
+    case NetworkLevel:
+        return quint64(uniqueCellId.mcc()) << 16 | uniqueCellId.mnc();
+    default:
+        return uniqueCellId.mcc();
+    }
+}
+
+QString MlsdbAreaTable::levelName(Level level)
+{
+    switch (level) {
+    case LocationCodeLevel: return QStringLiteral("location area");
+    case NetworkLevel:      return QStringLiteral("network");
+    default:                return QStringLiteral("country");
+    }
+}
@@ -0,0 +1,72 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef GEOCLUE_MLSDB_AREATABLE_H
+#define GEOCLUE_MLSDB_AREATABLE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+
+#include "mlsdbserialisation.h"
+
+#define MLSDB_AREAS_MAGIC 0xc710cde
+#define MLSDB_AREAS_VERSION 1
+#define MLSDB_AREAS_FILE_NAME "mlsdb.areas"
+
+struct MlsdbAreaLocation {
+    MlsdbAreaLocation() : radius(0), cellCount(0) { coords.lat = 0.0; coords.lon = 0.0; }
+    MlsdbCoords coords; // centroid of the cells of the area
+    quint32 radius;     // metres
+    quint32 cellCount;
+};
+
+/*
+ * The centroids of the cells of every location area (LAC or TAC), every
+ * network and every country in the database, stored as mlsdb.areas in
+ * the database directory.  They allow a coarse position to be given for
+ * cells which are not in the database themselves.
+ *
+ *   quint32 magic, qint32 version, then for each level: quint32 count,
+ *   followed by (quint64 key, double lat, double lon, quint32 radius, quint32 cellCount)
+ *
+ * GSM and UMTS location area codes share a key, LTE tracking area codes
+ * are kept apart from them.
+ */
+
+class MlsdbAreaTable
+{
+public:
+    enum Level {
+        LocationCodeLevel = 0,
+        NetworkLevel,
+        CountryLevel,
+        LevelCount
+    };
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    bool isEmpty() const;
+    void clear();
+
+    void insert(Level level, quint64 key, const MlsdbAreaLocation &location);
+
+    // finds the finest level area containing the cell.
+    bool lookup(const MlsdbUniqueCellId &uniqueCellId, MlsdbAreaLocation *location, Level *level) const;
+
+    static quint64 areaKey(Level level, const MlsdbUniqueCellId &uniqueCellId);
+    static QString levelName(Level level);
+
+private:
+    QHash<quint64, MlsdbAreaLocation> m_areas[LevelCount];
+};
+
+#endif // GEOCLUE_MLSDB_AREATABLE_H
@@ -0,0 +1,120 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbbloomfilter.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtDebug>
+
+namespace {
+    const quint32 BitsPerCell = 10;  // with 7 hashes, about 1% false positives
+    const quint32 HashCount = 7;
+    const quint32 MaximumHashCount = 16;
+}
+
+MlsdbBloomFilter::MlsdbBloomFilter()
+    : m_hashCount(HashCount)
+{
+}
+
+void MlsdbBloomFilter::reset(quint32 expectedCount)
+{
+    const quint64 bitCount = qMax<quint64>(64, quint64(expectedCount) * BitsPerCell);
+    m_bits.fill(0, int((bitCount + 63) / 64));
+    m_hashCount = HashCount;
+}
+
+quint64 MlsdbBloomFilter::cellHash(const MlsdbUniqueCellId &uniqueCellId)
+{
+    // the builder and the provider must agree on this, don't change it without
+    // bumping MLSDB_BLOOM_VERSION.
+    return mlsdbMixHash(mlsdbMixHash(quint64(uniqueCellId.m_mcc) << 48
+                                     | quint64(uniqueCellId.m_mnc) << 32
+                                     | uniqueCellId.m_locationCode)
+                        ^ uniqueCellId.m_cellId);
+}
+
+void MlsdbBloomFilter::insert(const MlsdbUniqueCellId &uniqueCellId)
+{
+    const quint64 hash = cellHash(uniqueCellId);
+    const quint64 bitCount = quint64(m_bits.size()) * 64;
+    const quint64 h1 = hash & 0xFFFFFFFF;
+    const quint64 h2 = (hash >> 32) | 1;
+    for (quint32 i = 0; i < m_hashCount; ++i) {
+        const quint64 bit = (h1 + i * h2) % bitCount;
+        m_bits[int(bit / 64)] |= Q_UINT64_C(1) << (bit % 64);
+    }
+}
+
+bool MlsdbBloomFilter::mayContain(const MlsdbUniqueCellId &uniqueCellId) const
+{
+    if (m_bits.isEmpty()) {
+        return true;
+    }
+
+    const quint64 hash = cellHash(uniqueCellId);
+    const quint64 bitCount = quint64(m_bits.size()) * 64;
+    const quint64 h1 = hash & 0xFFFFFFFF;
+    const quint64 h2 = (hash >> 32) | 1;
+    for (quint32 i = 0; i < m_hashCount; ++i) {
+        const quint64 bit = (h1 + i * h2) % bitCount;
+        if (!(m_bits.at(int(bit / 64)) & (Q_UINT64_C(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MlsdbBloomFilter::load(const QString &fileName)
+{
+    m_bits.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    quint32 hashCount = 0;
+    in >> magic >> version >> hashCount;
+    if (magic != MLSDB_BLOOM_MAGIC || version != MLSDB_BLOOM_VERSION
+            || hashCount == 0 || hashCount > MaximumHashCount) {
+        qDebug() << "geoclue-mlsdb bloom filter" << fileName << "format unknown:" << magic << version;
+        return false;
+    }
+
+    QVector<quint64> bits;
+    in >> bits;
+    if (in.status() != QDataStream::Ok || bits.isEmpty()) {
+        qDebug() << "geoclue-mlsdb bloom filter" << fileName << "is truncated";
+        return false;
+    }
+
+    m_bits = bits;
+    m_hashCount = hashCount;
+    return true;
+}
+
+bool MlsdbBloomFilter::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << quint32(MLSDB_BLOOM_MAGIC) << qint32(MLSDB_BLOOM_VERSION) << m_hashCount << m_bits;
+    return file.commit();
+}
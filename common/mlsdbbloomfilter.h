@@ -0,0 +1,58 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef GEOCLUE_MLSDB_BLOOMFILTER_H
+#define GEOCLUE_MLSDB_BLOOMFILTER_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "mlsdbserialisation.h"
+
+#define MLSDB_BLOOM_MAGIC 0xc710cdd
+#define MLSDB_BLOOM_VERSION 1
+#define MLSDB_BLOOM_FILE_NAME "mlsdb.bloom"
+
+/*
+ * A Bloom filter over the cell ids of a single mlsdb.data file, stored
+ * next to it as mlsdb.bloom.  A negative answer means the cell is
+ * definitely not in the data file, so the file needn't be searched.
+ *
+ *   quint32 magic, qint32 version, quint32 hashCount, QVector<quint64> bits
+ *
+ * The bits are set by double hashing of a 64 bit hash of the cell id.
+ */
+
+class MlsdbBloomFilter
+{
+public:
+    MlsdbBloomFilter();
+
+    // sizes the filter for the given number of cells, at about 1% false positives.
+    void reset(quint32 expectedCount);
+
+    bool isValid() const { return !m_bits.isEmpty(); }
+    int sizeInBytes() const { return m_bits.size() * int(sizeof(quint64)); }
+
+    void insert(const MlsdbUniqueCellId &uniqueCellId);
+    bool mayContain(const MlsdbUniqueCellId &uniqueCellId) const;
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+private:
+    static quint64 cellHash(const MlsdbUniqueCellId &uniqueCellId);
+
+    QVector<quint64> m_bits;
+    quint32 m_hashCount;
+};
+
+#endif // GEOCLUE_MLSDB_BLOOMFILTER_H
@@ -0,0 +1,161 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbindexfile.h"
+
+#include <QtCore/QtEndian>
+#include <QtCore/QtDebug>
+#include <QtCore/qmath.h>
+
+#include <string.h>
+#include <sys/mman.h>
+
+void mlsdbIndexKey(const MlsdbUniqueCellId &uniqueCellId, uchar *key)
+{
+    qToBigEndian<quint16>(uniqueCellId.m_mcc, key);
+    qToBigEndian<quint16>(uniqueCellId.m_mnc, key + 2);
+    qToBigEndian<quint32>(uniqueCellId.m_locationCode, key + 4);
+    qToBigEndian<quint32>(uniqueCellId.m_cellId, key + 8);
+}
+
+void mlsdbIndexRecord(const MlsdbUniqueCellId &uniqueCellId, const MlsdbCoords &coords, uchar *record)
+{
+    mlsdbIndexKey(uniqueCellId, record);
+    qToBigEndian<qint32>(qRound(coords.lat * MLSDB_INDEX_COORD_SCALE), record + MLSDB_INDEX_KEY_SIZE);
+    qToBigEndian<qint32>(qRound(coords.lon * MLSDB_INDEX_COORD_SCALE), record + MLSDB_INDEX_KEY_SIZE + 4);
+}
+
+void mlsdbIndexHeader(quint32 recordCount, uchar *header)
+{
+    qToBigEndian<quint32>(MLSDB_DATA_MAGIC, header);
+    qToBigEndian<qint32>(MLSDB_DATA_VERSION_INDEX, header + 4);
+    qToBigEndian<quint32>(recordCount, header + 8);
+    qToBigEndian<quint32>(MLSDB_INDEX_RECORD_SIZE, header + 12);
+}
+
+MlsdbUniqueCellId mlsdbIndexRecordCellId(const uchar *record)
+{
+    MlsdbUniqueCellId uniqueCellId;
+    uniqueCellId.m_mcc = qFromBigEndian<quint16>(record);
+    uniqueCellId.m_mnc = qFromBigEndian<quint16>(record + 2);
+    uniqueCellId.m_locationCode = qFromBigEndian<quint32>(record + 4);
+    uniqueCellId.m_cellId = qFromBigEndian<quint32>(record + 8);
+    return uniqueCellId;
+}
+
+MlsdbCoords mlsdbIndexRecordCoords(const uchar *record)
+{
+    MlsdbCoords coords;
+    coords.lat = qFromBigEndian<qint32>(record + MLSDB_INDEX_KEY_SIZE) / MLSDB_INDEX_COORD_SCALE;
+    coords.lon = qFromBigEndian<qint32>(record + MLSDB_INDEX_KEY_SIZE + 4) / MLSDB_INDEX_COORD_SCALE;
+    return coords;
+}
+
+MlsdbIndexFile::MlsdbIndexFile()
+    : m_map(0)
+    , m_records(0)
+    , m_recordCount(0)
+{
+}
+
+MlsdbIndexFile::~MlsdbIndexFile()
+{
+    close();
+}
+
+bool MlsdbIndexFile::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qDebug() << "geoclue-mlsdb data file" << fileName << "cannot be opened:" << m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    if (size < MLSDB_INDEX_HEADER_SIZE) {
+        qDebug() << "geoclue-mlsdb data file" << fileName << "is truncated";
+        m_file.close();
+        return false;
+    }
+
+    m_map = m_file.map(0, size);
+    if (!m_map) {
+        qDebug() << "geoclue-mlsdb data file" << fileName << "cannot be mapped:" << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    const quint32 magic = qFromBigEndian<quint32>(m_map);
+    const qint32 version = qFromBigEndian<qint32>(m_map + 4);
+    const quint32 recordCount = qFromBigEndian<quint32>(m_map + 8);
+    const quint32 recordSize = qFromBigEndian<quint32>(m_map + 12);
+    if (magic != MLSDB_DATA_MAGIC || version != MLSDB_DATA_VERSION_INDEX) {
+        qDebug() << "geoclue-mlsdb data file" << fileName << "is not an index file:" << magic << version;
+        close();
+        return false;
+    }
+    if (recordSize != MLSDB_INDEX_RECORD_SIZE
+            || size < MLSDB_INDEX_HEADER_SIZE + qint64(recordCount) * MLSDB_INDEX_RECORD_SIZE) {
+        qDebug() << "geoclue-mlsdb data file" << fileName << "has invalid record layout:" << recordCount << recordSize;
+        close();
+        return false;
+    }
+
+    // lookups jump around the file, don't let the kernel read ahead.
+    madvise(m_map, size, MADV_RANDOM);
+
+    m_records = m_map + MLSDB_INDEX_HEADER_SIZE;
+    m_recordCount = recordCount;
+    return true;
+}
+
+void MlsdbIndexFile::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = 0;
+    }
+    m_records = 0;
+    m_recordCount = 0;
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool MlsdbIndexFile::lookup(const MlsdbUniqueCellId &uniqueCellId, MlsdbCoords *coords) const
+{
+    if (!m_records) {
+        return false;
+    }
+
+    uchar key[MLSDB_INDEX_KEY_SIZE];
+    mlsdbIndexKey(uniqueCellId, key);
+
+    quint32 lower = 0;
+    quint32 upper = m_recordCount;
+    while (lower < upper) {
+        const quint32 middle = lower + (upper - lower) / 2;
+        const uchar *record = m_records + qint64(middle) * MLSDB_INDEX_RECORD_SIZE;
+        const int cmp = memcmp(record, key, MLSDB_INDEX_KEY_SIZE);
+        if (cmp == 0) {
+            *coords = mlsdbIndexRecordCoords(record);
+            return true;
+        } else if (cmp < 0) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+
+    return false;
+}
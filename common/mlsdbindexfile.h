@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef GEOCLUE_MLSDB_INDEXFILE_H
+#define GEOCLUE_MLSDB_INDEXFILE_H
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+#include "mlsdbserialisation.h"
+
+/*
+ * Version 4 of the mlsdb.data format.  All values are big-endian.
+ *
+ *   header:  quint32 magic, qint32 version, quint32 recordCount, quint32 recordSize
+ *   records: quint16 mcc, quint16 mnc, quint32 locationCode, quint32 cellId (incl. type),
+ *            qint32 latitude, qint32 longitude (both in 1e-7 degrees)
+ *
+ * Records are sorted by their first MLSDB_INDEX_KEY_SIZE bytes, so that the
+ * file can be mapped into memory and binary searched in place.
+ */
+
+#define MLSDB_INDEX_HEADER_SIZE 16
+#define MLSDB_INDEX_KEY_SIZE 12
+#define MLSDB_INDEX_RECORD_SIZE 20
+#define MLSDB_INDEX_COORD_SCALE 10000000.0
+
+void mlsdbIndexKey(const MlsdbUniqueCellId &uniqueCellId, uchar *key);
+void mlsdbIndexRecord(const MlsdbUniqueCellId &uniqueCellId, const MlsdbCoords &coords, uchar *record);
+void mlsdbIndexHeader(quint32 recordCount, uchar *header);
+MlsdbUniqueCellId mlsdbIndexRecordCellId(const uchar *record);
+MlsdbCoords mlsdbIndexRecordCoords(const uchar *record);
+
+class MlsdbIndexFile
+{
+public:
+    MlsdbIndexFile();
+    ~MlsdbIndexFile();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const { return m_records != 0; }
+    QString fileName() const { return m_file.fileName(); }
+    quint32 recordCount() const { return m_recordCount; }
+
+    bool lookup(const MlsdbUniqueCellId &uniqueCellId, MlsdbCoords *coords) const;
+
+private:
+    Q_DISABLE_COPY(MlsdbIndexFile)
+
+    QFile m_file;
+    uchar *m_map;
+    const uchar *m_records;
+    quint32 m_recordCount;
+};
+
+#endif // GEOCLUE_MLSDB_INDEXFILE_H
@@ -12,6 +12,15 @@
 
 #include "mlsdbserialisation.h"
 
+namespace {
+    enum MapOrder {
+        UnknownOrder,
+        AscendingOrder,
+        DescendingOrder,
+        Unordered
+    };
+}
+
 QDataStream &operator<<(QDataStream &out, const MlsdbCoords &coords)
 {
     out << coords.lat << coords.lon;
@@ -38,7 +47,105 @@ QDataStream &operator>>(QDataStream &in, MlsdbUniqueCellId &cellId)
 
 uint qHash(const MlsdbUniqueCellId &key)
 {
-    return key.m_cellId;
+    // the cell id alone collides across operators, mix in every field.
+    const quint64 h = mlsdbMixHash((quint64(key.m_cellId) << 32 | key.m_locationCode)
+                                   ^ (quint64(key.m_mcc) << 48 | quint64(key.m_mnc) << 32));
+    return uint(h ^ (h >> 32));
+}
+
+bool mlsdbPackCellId(const MlsdbUniqueCellId &uniqueCellId, quint64 *key)
+{
+    if (uniqueCellId.mcc() > 0x3FF || uniqueCellId.mnc() > 0x3FF || uniqueCellId.locationCode() > 0xFFFF) {
+        return false;
+    }
+    *key = quint64(uniqueCellId.mcc()) << 54
+         | quint64(uniqueCellId.mnc()) << 44
+         | quint64(uniqueCellId.locationCode()) << 28
+         | quint64(uniqueCellId.cellId());
+    return true;
+}
+
+MlsdbUniqueCellId mlsdbUnpackCellId(quint64 key, MlsdbCellType cellType)
+{
+    return MlsdbUniqueCellId(cellType,
+                             quint32(key & 0x0FFFFFFF),
+                             quint32((key >> 28) & 0xFFFF),
+                             quint16((key >> 54) & 0x3FF),
+                             quint16((key >> 44) & 0x3FF));
+}
+
+quint64 mlsdbMixHash(quint64 key)
+{
+    // splitmix64 finaliser
+    key ^= key >> 30;
+    key *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+    key ^= key >> 27;
+    key *= Q_UINT64_C(0x94d049bb133111eb);
+    key ^= key >> 31;
+    return key;
+}
+
+QString mlsdbBucketForCellId(const MlsdbUniqueCellId &uniqueCellId)
+{
+    // the mlsdb data files are separated into "first digit of location code" directories/buckets.
+    return QString::number(uniqueCellId.locationCode()).left(1);
+}
+
+quint32 mlsdbStreamingLookup(QDataStream &in, QList<MlsdbUniqueCellId> *cellIds,
+                             QMap<MlsdbUniqueCellId, MlsdbCoords> *cellLocations)
+{
+    quint32 count = 0;
+    in >> count;
+
+    // QMap serialises its entries in key order (descending, so that the last inserted
+    // value wins when read back), which lets us stop as soon as every remaining target
+    // has been passed.  Detect the direction from the data rather than relying on it.
+    MapOrder order = UnknownOrder;
+    MlsdbUniqueCellId previous;
+    quint32 read = 0;
+    while (read < count && !cellIds->isEmpty() && in.status() == QDataStream::Ok) {
+        MlsdbUniqueCellId uniqueCellId;
+        MlsdbCoords coords;
+        in >> uniqueCellId >> coords;
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+
+        if (read > 0 && order != Unordered) {
+            const MapOrder direction = previous < uniqueCellId ? AscendingOrder
+                                     : uniqueCellId < previous ? DescendingOrder
+                                     : order;
+            if (order == UnknownOrder) {
+                order = direction;
+            } else if (direction != order) {
+                order = Unordered;
+            }
+        }
+        previous = uniqueCellId;
+        ++read;
+
+        const int index = cellIds->indexOf(uniqueCellId);
+        if (index >= 0) {
+            cellLocations->insert(uniqueCellId, coords);
+            cellIds->removeAt(index);
+            continue;
+        }
+
+        if (order == AscendingOrder || order == DescendingOrder) {
+            bool passedAll = true;
+            Q_FOREACH (const MlsdbUniqueCellId &target, *cellIds) {
+                if (order == AscendingOrder ? !(target < uniqueCellId) : !(uniqueCellId < target)) {
+                    passedAll = false;
+                    break;
+                }
+            }
+            if (passedAll) {
+                break;
+            }
+        }
+    }
+
+    return read;
 }
 
 QString stringForMlsdbCellType(MlsdbCellType type)
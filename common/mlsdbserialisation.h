@@ -14,6 +14,13 @@
 #define GEOCLUE_MLSDB_SERIALISATION_H
 
 #include <QDataStream>
+#include <QList>
+#include <QMap>
+
+// every mlsdb.data file starts with this magic number followed by a qint32 format version.
+#define MLSDB_DATA_MAGIC 0xc710cdb
+#define MLSDB_DATA_VERSION_MAP 3    // QDataStream serialised QMap<MlsdbUniqueCellId, MlsdbCoords>
+#define MLSDB_DATA_VERSION_INDEX 4  // sorted fixed-width records, see mlsdbindexfile.h
 
 struct MlsdbCoords {
     double lat;
@@ -85,4 +92,21 @@ QDataStream &operator<<(QDataStream &out, const MlsdbUniqueCellId &cellId);
 QDataStream &operator>>(QDataStream &in, MlsdbUniqueCellId &cellId);
 uint qHash(const MlsdbUniqueCellId &key);
 
+// Packs a cell id into 64 bits: mcc (10 bits), mnc (10 bits), location code (16 bits)
+// and cell id (28 bits).  The cell type is not part of the packed key.
+// Returns false if any of the values doesn't fit.
+bool mlsdbPackCellId(const MlsdbUniqueCellId &uniqueCellId, quint64 *key);
+MlsdbUniqueCellId mlsdbUnpackCellId(quint64 key, MlsdbCellType cellType);
+quint64 mlsdbMixHash(quint64 key);
+
+// Databases without a shard manifest are split into buckets by the first digit of
+// the location code, each stored as <bucket>/mlsdb.data below the database directory.
+QString mlsdbBucketForCellId(const MlsdbUniqueCellId &uniqueCellId);
+
+// Searches a serialised QMap<MlsdbUniqueCellId, MlsdbCoords> for the given cell ids,
+// record by record, without materialising the map.  Found cell ids are removed from
+// the list.  Returns the number of records which were read.
+quint32 mlsdbStreamingLookup(QDataStream &in, QList<MlsdbUniqueCellId> *cellIds,
+                             QMap<MlsdbUniqueCellId, MlsdbCoords> *cellLocations);
+
 #endif // GEOCLUE_MLSDB_SERIALISATION_H
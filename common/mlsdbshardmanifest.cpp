@@ -0,0 +1,102 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbshardmanifest.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtDebug>
+
+bool MlsdbShardManifest::load(const QString &fileName)
+{
+    m_networks.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != MLSDB_MANIFEST_MAGIC || version != MLSDB_MANIFEST_VERSION) {
+        qDebug() << "geoclue-mlsdb manifest" << fileName << "format unknown:" << magic << version;
+        return false;
+    }
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint16 mcc = 0, mnc = 0;
+        QVector<quint32> shardSizes;
+        in >> mcc >> mnc >> shardSizes;
+        if (in.status() == QDataStream::Ok && !shardSizes.isEmpty()) {
+            m_networks.insert(networkKey(mcc, mnc), shardSizes);
+        }
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "geoclue-mlsdb manifest" << fileName << "is truncated";
+        m_networks.clear();
+        return false;
+    }
+    return true;
+}
+
+bool MlsdbShardManifest::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << quint32(MLSDB_MANIFEST_MAGIC) << qint32(MLSDB_MANIFEST_VERSION) << quint32(m_networks.size());
+    QHash<quint32, QVector<quint32> >::const_iterator it = m_networks.constBegin();
+    for (; it != m_networks.constEnd(); ++it) {
+        out << quint16(it.key() >> 16) << quint16(it.key() & 0xFFFF) << it.value();
+    }
+    return file.commit();
+}
+
+void MlsdbShardManifest::setShardSizes(quint16 mcc, quint16 mnc, const QVector<quint32> &shardSizes)
+{
+    m_networks.insert(networkKey(mcc, mnc), shardSizes);
+}
+
+QVector<quint32> MlsdbShardManifest::shardSizes(quint16 mcc, quint16 mnc) const
+{
+    return m_networks.value(networkKey(mcc, mnc));
+}
+
+QString MlsdbShardManifest::shardForCellId(const MlsdbUniqueCellId &uniqueCellId) const
+{
+    QHash<quint32, QVector<quint32> >::const_iterator it
+            = m_networks.constFind(networkKey(uniqueCellId.mcc(), uniqueCellId.mnc()));
+    if (it == m_networks.constEnd()) {
+        return QString();
+    }
+    return shardName(uniqueCellId.mcc(), uniqueCellId.mnc(),
+                     shardIndex(uniqueCellId.locationCode(), it.value().size()));
+}
+
+quint32 MlsdbShardManifest::shardIndex(quint32 locationCode, quint32 shardCount)
+{
+    // the builder and the provider must agree on this, don't change it without
+    // bumping MLSDB_MANIFEST_VERSION.
+    return shardCount <= 1 ? 0 : quint32(mlsdbMixHash(locationCode) % shardCount);
+}
+
+QString MlsdbShardManifest::shardName(quint16 mcc, quint16 mnc, quint32 shardIndex)
+{
+    return QStringLiteral("%1/%2/%3").arg(mcc).arg(mnc).arg(shardIndex);
+}
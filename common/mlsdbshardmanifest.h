@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef GEOCLUE_MLSDB_SHARDMANIFEST_H
+#define GEOCLUE_MLSDB_SHARDMANIFEST_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "mlsdbserialisation.h"
+
+#define MLSDB_MANIFEST_MAGIC 0xc710cdc
+#define MLSDB_MANIFEST_VERSION 1
+#define MLSDB_MANIFEST_FILE_NAME "mlsdb.manifest"
+
+/*
+ * Databases built with a shard manifest are split per network: the cells
+ * of network (mcc, mnc) are spread over that network's shards by a hash
+ * of their location code, and each shard is stored as
+ * <mcc>/<mnc>/<shard>/mlsdb.data below the database directory.
+ *
+ * The manifest records the number of shards of every network, and the
+ * number of cells in each shard.  Databases without a manifest use the
+ * legacy "first digit of location code" buckets.
+ */
+
+class MlsdbShardManifest
+{
+public:
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    bool isEmpty() const { return m_networks.isEmpty(); }
+    void clear() { m_networks.clear(); }
+
+    void setShardSizes(quint16 mcc, quint16 mnc, const QVector<quint32> &shardSizes);
+    QVector<quint32> shardSizes(quint16 mcc, quint16 mnc) const;
+
+    // returns an empty string if the network is not in the database.
+    QString shardForCellId(const MlsdbUniqueCellId &uniqueCellId) const;
+
+    static quint32 shardIndex(quint32 locationCode, quint32 shardCount);
+    static QString shardName(quint16 mcc, quint16 mnc, quint32 shardIndex);
+
+private:
+    static quint32 networkKey(quint16 mcc, quint16 mnc) { return quint32(mcc) << 16 | mnc; }
+
+    QHash<quint32, QVector<quint32> > m_networks;
+};
+
+#endif // GEOCLUE_MLSDB_SHARDMANIFEST_H
@@ -0,0 +1,189 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef YANDEXPOSITIONFEED_H
+#define YANDEXPOSITIONFEED_H
+
+#include <QtCore/QtGlobal>
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * The position feed is a small POSIX shared memory segment to which the
+ * provider publishes every fix, so that clients which need the position
+ * many times a second can read it without a D-Bus round trip.  Change
+ * notification is still done with the PositionChanged signal.
+ *
+ * The fix is protected by a sequence lock: the sequence number is odd
+ * while the provider writes, and a reader retries if it changed during
+ * its copy.  The fix is kept in atomic 32 bit words, which both sides
+ * access with relaxed loads and stores, so that the concurrent copy is
+ * well defined.  The generation counts the published fixes.  The segment
+ * outlives the provider, which publishes an invalid fix (timestamp 0)
+ * when it quits and continues from there when it is started again.
+ *
+ * The reader is header only, clients need to link with -lrt.
+ */
+
+#define YANDEX_POSITION_FEED_MAGIC 0x79706f73 // "ypos"
+#define YANDEX_POSITION_FEED_VERSION 2
+
+// word offsets of the fix, 64 bit values take two words, low word first.
+enum YandexPositionFeedWord {
+    YandexPositionFeedGeneration = 0,           // number of fixes published
+    YandexPositionFeedTimestamp = 1,            // msecs since epoch, 0 if there is no fix
+    YandexPositionFeedFields = 3,               // GeocluePositionFields
+    YandexPositionFeedLatitude = 4,
+    YandexPositionFeedLongitude = 6,
+    YandexPositionFeedAltitude = 8,
+    YandexPositionFeedHorizontalAccuracy = 10,
+    YandexPositionFeedVerticalAccuracy = 12,
+    YandexPositionFeedWordCount = 14
+};
+
+struct YandexPositionFeedData {
+    quint32 magic;
+    quint32 version;
+    std::atomic<quint32> sequence;  // odd while the fix below is being written
+    std::atomic<quint32> words[YandexPositionFeedWordCount];
+};
+// the segment is shared between processes, so the atomics must not use locks.
+Q_STATIC_ASSERT(ATOMIC_INT_LOCK_FREE == 2);
+Q_STATIC_ASSERT(sizeof(std::atomic<quint32>) == sizeof(quint32));
+
+inline quint64 yandexPositionFeedLoad(const YandexPositionFeedData *data, int word)
+{
+    return quint64(data->words[word].load(std::memory_order_relaxed))
+         | (quint64(data->words[word + 1].load(std::memory_order_relaxed)) << 32);
+}
+
+inline void yandexPositionFeedStore(YandexPositionFeedData *data, int word, quint64 value)
+{
+    data->words[word].store(quint32(value), std::memory_order_relaxed);
+    data->words[word + 1].store(quint32(value >> 32), std::memory_order_relaxed);
+}
+
+inline double yandexPositionFeedLoadDouble(const YandexPositionFeedData *data, int word)
+{
+    const quint64 bits = yandexPositionFeedLoad(data, word);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void yandexPositionFeedStoreDouble(YandexPositionFeedData *data, int word, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    yandexPositionFeedStore(data, word, bits);
+}
+
+struct YandexPositionFeedSample {
+    quint32 generation;
+    qint64 timestamp;
+    qint32 fields;
+    double latitude;
+    double longitude;
+    double altitude;
+    double horizontalAccuracy;
+    double verticalAccuracy;
+};
+
+// the segment is per user, like the session bus the provider runs on, and
+// only that user may open it.
+inline void yandexPositionFeedName(char *name, size_t size)
+{
+    snprintf(name, size, "/geoclue-yandex-position-%u", unsigned(getuid()));
+}
+
+class YandexPositionFeedReader
+{
+public:
+    YandexPositionFeedReader() : m_data(0) {}
+    ~YandexPositionFeedReader() { close(); }
+
+    bool open()
+    {
+        close();
+        char name[64];
+        yandexPositionFeedName(name, sizeof(name));
+        const int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        void *data = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size >= off_t(sizeof(YandexPositionFeedData))) {
+            data = mmap(0, sizeof(YandexPositionFeedData), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        m_data = static_cast<const YandexPositionFeedData *>(data);
+        if (m_data->magic != YANDEX_POSITION_FEED_MAGIC || m_data->version != YANDEX_POSITION_FEED_VERSION) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (m_data) {
+            munmap(const_cast<YandexPositionFeedData *>(m_data), sizeof(YandexPositionFeedData));
+            m_data = 0;
+        }
+    }
+
+    bool isOpen() const { return m_data != 0; }
+
+    // copies the latest fix, returns false if the provider kept writing
+    // during every attempt, which only happens if it is stopped mid-write.
+    bool read(YandexPositionFeedSample *sample, int attempts = 1000) const
+    {
+        if (!m_data) {
+            return false;
+        }
+        for (int i = 0; i < attempts; ++i) {
+            const quint32 before = m_data->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            sample->generation = m_data->words[YandexPositionFeedGeneration].load(std::memory_order_relaxed);
+            sample->timestamp = qint64(yandexPositionFeedLoad(m_data, YandexPositionFeedTimestamp));
+            sample->fields = qint32(m_data->words[YandexPositionFeedFields].load(std::memory_order_relaxed));
+            sample->latitude = yandexPositionFeedLoadDouble(m_data, YandexPositionFeedLatitude);
+            sample->longitude = yandexPositionFeedLoadDouble(m_data, YandexPositionFeedLongitude);
+            sample->altitude = yandexPositionFeedLoadDouble(m_data, YandexPositionFeedAltitude);
+            sample->horizontalAccuracy = yandexPositionFeedLoadDouble(m_data, YandexPositionFeedHorizontalAccuracy);
+            sample->verticalAccuracy = yandexPositionFeedLoadDouble(m_data, YandexPositionFeedVerticalAccuracy);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_data->sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    Q_DISABLE_COPY(YandexPositionFeedReader)
+
+    const YandexPositionFeedData *m_data;
+};
+
+#endif // YANDEXPOSITIONFEED_H
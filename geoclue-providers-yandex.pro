@@ -1,4 +1,4 @@
 TEMPLATE=subdirs
-SUBDIRS=plugin
+SUBDIRS=plugin tools
 OTHER_FILES = rpm/geoclue-providers-yandex.spec \
               README
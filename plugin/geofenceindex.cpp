@@ -0,0 +1,244 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "geofenceindex.h"
+
+#include <QtCore/qmath.h>
+#include <QtCore/qnumeric.h>
+
+namespace {
+    const double GridSize = 0.05;               // degrees, about 5.5km north-south
+    const int MaximumGridCells = 1024;          // geofences covering more grid cells are kept aside
+    const double MetresPerDegree = 111320.0;    // of latitude, and of longitude at the equator
+
+    double metresPerDegreeLongitude(double latitude)
+    {
+        return MetresPerDegree * qMax(0.01, qCos(qDegreesToRadians(latitude)));
+    }
+
+    int gridRow(double latitude)
+    {
+        return qBound(0, int(qFloor((latitude + 90.0) / GridSize)), int(180.0 / GridSize));
+    }
+
+    int gridColumn(double longitude)
+    {
+        return qBound(0, int(qFloor((longitude + 180.0) / GridSize)), int(360.0 / GridSize));
+    }
+
+    double segmentDistance(double ax, double ay, double bx, double by)
+    {
+        // distance of the origin from the segment a-b.
+        const double dx = bx - ax;
+        const double dy = by - ay;
+        const double lengthSquared = dx * dx + dy * dy;
+        const double t = lengthSquared > 0 ? qBound(0.0, -(ax * dx + ay * dy) / lengthSquared, 1.0) : 0.0;
+        const double x = ax + t * dx;
+        const double y = ay + t * dy;
+        return qSqrt(x * x + y * y);
+    }
+}
+
+GeofenceIndex::GeofenceIndex()
+    : m_nextId(1)
+{
+}
+
+quint32 GeofenceIndex::addCircle(const QString &owner, const MlsdbCoords &center, double radius)
+{
+    Geofence geofence;
+    geofence.owner = owner;
+    geofence.center = center;
+    geofence.radius = radius;
+    const double latitudeRadius = radius / MetresPerDegree;
+    const double longitudeRadius = radius / metresPerDegreeLongitude(center.lat);
+    geofence.minLat = center.lat - latitudeRadius;
+    geofence.maxLat = center.lat + latitudeRadius;
+    geofence.minLon = center.lon - longitudeRadius;
+    geofence.maxLon = center.lon + longitudeRadius;
+    return insert(geofence);
+}
+
+quint32 GeofenceIndex::addPolygon(const QString &owner, const QVector<MlsdbCoords> &vertices)
+{
+    Geofence geofence;
+    geofence.owner = owner;
+    geofence.radius = 0;
+    geofence.vertices = vertices;
+    geofence.minLat = geofence.maxLat = vertices.first().lat;
+    geofence.minLon = geofence.maxLon = vertices.first().lon;
+    Q_FOREACH (const MlsdbCoords &vertex, vertices) {
+        geofence.minLat = qMin(geofence.minLat, vertex.lat);
+        geofence.maxLat = qMax(geofence.maxLat, vertex.lat);
+        geofence.minLon = qMin(geofence.minLon, vertex.lon);
+        geofence.maxLon = qMax(geofence.maxLon, vertex.lon);
+    }
+    return insert(geofence);
+}
+
+quint32 GeofenceIndex::insert(const Geofence &geofence)
+{
+    const quint32 id = m_nextId++;
+    Geofence &inserted(m_geofences[id]);
+    inserted = geofence;
+
+    const qint64 rows = gridRow(geofence.maxLat) - gridRow(geofence.minLat) + 1;
+    const qint64 columns = gridColumn(geofence.maxLon) - gridColumn(geofence.minLon) + 1;
+    inserted.oversized = rows * columns > MaximumGridCells;
+    if (inserted.oversized) {
+        m_oversized.insert(id);
+    } else {
+        Q_FOREACH (quint64 key, gridKeys(geofence.minLat, geofence.maxLat, geofence.minLon, geofence.maxLon)) {
+            m_grid[key].append(id);
+        }
+    }
+    return id;
+}
+
+bool GeofenceIndex::remove(const QString &owner, quint32 id)
+{
+    QHash<quint32, Geofence>::iterator it = m_geofences.find(id);
+    if (it == m_geofences.end() || it->owner != owner) {
+        return false;
+    }
+
+    if (it->oversized) {
+        m_oversized.remove(id);
+    } else {
+        Q_FOREACH (quint64 key, gridKeys(it->minLat, it->maxLat, it->minLon, it->maxLon)) {
+            QHash<quint64, QVector<quint32> >::iterator cell = m_grid.find(key);
+            if (cell != m_grid.end()) {
+                cell->removeAll(id);
+                if (cell->isEmpty()) {
+                    m_grid.erase(cell);
+                }
+            }
+        }
+    }
+    m_inside.remove(id);
+    m_geofences.erase(it);
+    return true;
+}
+
+void GeofenceIndex::removeOwner(const QString &owner)
+{
+    QList<quint32> ids;
+    for (QHash<quint32, Geofence>::const_iterator it = m_geofences.constBegin(); it != m_geofences.constEnd(); ++it) {
+        if (it->owner == owner) {
+            ids.append(it.key());
+        }
+    }
+    Q_FOREACH (quint32 id, ids) {
+        remove(owner, id);
+    }
+}
+
+int GeofenceIndex::count(const QString &owner) const
+{
+    int count = 0;
+    for (QHash<quint32, Geofence>::const_iterator it = m_geofences.constBegin(); it != m_geofences.constEnd(); ++it) {
+        if (it->owner == owner) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+QList<quint64> GeofenceIndex::gridKeys(double minLat, double maxLat, double minLon, double maxLon) const
+{
+    QList<quint64> keys;
+    const int lastRow = gridRow(maxLat);
+    const int lastColumn = gridColumn(maxLon);
+    for (int row = gridRow(minLat); row <= lastRow; ++row) {
+        for (int column = gridColumn(minLon); column <= lastColumn; ++column) {
+            keys.append((quint64(row) << 32) | quint32(column));
+        }
+    }
+    return keys;
+}
+
+double GeofenceIndex::signedDistance(const Geofence &geofence, const MlsdbCoords &position)
+{
+    // work in metres on a plane tangent at the position, which is at the origin.
+    const double metresPerLon = metresPerDegreeLongitude(position.lat);
+    if (geofence.vertices.isEmpty()) {
+        const double x = (geofence.center.lon - position.lon) * metresPerLon;
+        const double y = (geofence.center.lat - position.lat) * MetresPerDegree;
+        return qSqrt(x * x + y * y) - geofence.radius;
+    }
+
+    bool inside = false;
+    double distance = -1;
+    const QVector<MlsdbCoords> &vertices(geofence.vertices);
+    for (int i = 0, j = vertices.size() - 1; i < vertices.size(); j = i++) {
+        const double ax = (vertices.at(j).lon - position.lon) * metresPerLon;
+        const double ay = (vertices.at(j).lat - position.lat) * MetresPerDegree;
+        const double bx = (vertices.at(i).lon - position.lon) * metresPerLon;
+        const double by = (vertices.at(i).lat - position.lat) * MetresPerDegree;
+        if ((ay > 0) != (by > 0) && 0 < ax + (bx - ax) * (0 - ay) / (by - ay)) {
+            inside = !inside;
+        }
+        const double edgeDistance = segmentDistance(ax, ay, bx, by);
+        if (distance < 0 || edgeDistance < distance) {
+            distance = edgeDistance;
+        }
+    }
+    return inside ? -distance : distance;
+}
+
+QList<GeofenceIndex::Event> GeofenceIndex::update(const MlsdbCoords &position, double accuracy)
+{
+    const double margin = (qIsNaN(accuracy) || accuracy < 0) ? 0.0 : accuracy / 2;
+
+    // only the geofences within the margin of the fix may be entered, and
+    // those the fix was inside of but are further away are left.
+    const double latitudeMargin = margin / MetresPerDegree;
+    const double longitudeMargin = margin / metresPerDegreeLongitude(position.lat);
+    QSet<quint32> candidates(m_oversized);
+    Q_FOREACH (quint64 key, gridKeys(position.lat - latitudeMargin, position.lat + latitudeMargin,
+                                     position.lon - longitudeMargin, position.lon + longitudeMargin)) {
+        const QHash<quint64, QVector<quint32> >::const_iterator cell = m_grid.constFind(key);
+        if (cell != m_grid.constEnd()) {
+            Q_FOREACH (quint32 id, *cell) {
+                candidates.insert(id);
+            }
+        }
+    }
+
+    QList<Event> events;
+    Q_FOREACH (quint32 id, candidates) {
+        const Geofence &geofence(m_geofences[id]);
+        // geofences sharing a grid cell with the fix may still be too far away to test.
+        const bool near = position.lat + latitudeMargin >= geofence.minLat
+                       && position.lat - latitudeMargin <= geofence.maxLat
+                       && position.lon + longitudeMargin >= geofence.minLon
+                       && position.lon - longitudeMargin <= geofence.maxLon;
+        const double distance = near ? signedDistance(geofence, position) : qInf();
+        const bool wasInside = m_inside.contains(id);
+        if (!wasInside && distance <= -margin) {
+            m_inside.insert(id);
+            Event event = { id, geofence.owner, Entered };
+            events.append(event);
+        } else if (wasInside && distance >= margin) {
+            m_inside.remove(id);
+            Event event = { id, geofence.owner, Exited };
+            events.append(event);
+        }
+    }
+
+    Q_FOREACH (quint32 id, QSet<quint32>(m_inside).subtract(candidates)) {
+        m_inside.remove(id);
+        Event event = { id, m_geofences.value(id).owner, Exited };
+        events.append(event);
+    }
+
+    return events;
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef GEOFENCEINDEX_H
+#define GEOFENCEINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "mlsdbserialisation.h"
+
+/*
+ * The GeofenceIndex class keeps the circular and polygonal geofences
+ * registered by the clients, and determines which of them a new fix
+ * entered or left.
+ *
+ * The bounding boxes of the geofences are kept in a grid of fixed size
+ * cells, so that only the geofences near the fix are tested.  The fix has
+ * to be inside a geofence by half its accuracy radius to enter it, and
+ * outside by as much to leave it; in between, the previous state is kept.
+ * The grid doesn't wrap around the antimeridian.
+ */
+
+class GeofenceIndex
+{
+public:
+    enum Transition {
+        Entered = 1,
+        Exited = 2
+    };
+
+    struct Event {
+        quint32 id;
+        QString owner;
+        Transition transition;
+    };
+
+    GeofenceIndex();
+
+    quint32 addCircle(const QString &owner, const MlsdbCoords &center, double radius);
+    quint32 addPolygon(const QString &owner, const QVector<MlsdbCoords> &vertices);
+    bool remove(const QString &owner, quint32 id);
+    void removeOwner(const QString &owner);
+    int count(const QString &owner) const;
+    bool isEmpty() const { return m_geofences.isEmpty(); }
+
+    QList<Event> update(const MlsdbCoords &position, double accuracy);
+
+private:
+    struct Geofence {
+        QString owner;
+        MlsdbCoords center;             // circles
+        double radius;
+        QVector<MlsdbCoords> vertices;  // polygons
+        double minLat;                  // bounding box
+        double maxLat;
+        double minLon;
+        double maxLon;
+        bool oversized;                 // covers too many grid cells, tested for every fix
+    };
+
+    quint32 insert(const Geofence &geofence);
+    QList<quint64> gridKeys(double minLat, double maxLat, double minLon, double maxLon) const;
+    static double signedDistance(const Geofence &geofence, const MlsdbCoords &position);
+
+    QHash<quint32, Geofence> m_geofences;
+    QHash<quint64, QVector<quint32> > m_grid;   // grid cell -> geofences overlapping it
+    QSet<quint32> m_oversized;
+    QSet<quint32> m_inside;
+    quint32 m_nextId;
+};
+
+#endif // GEOFENCEINDEX_H
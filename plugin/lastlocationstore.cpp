@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "lastlocationstore.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtDebug>
+
+namespace {
+    const quint32 LastLocationMagic = 0x6c6c6f63; // "lloc"
+    const qint32 LastLocationVersion = 1;
+}
+
+bool LastLocationStore::load(const QString &fileName, Location *location,
+                             QList<MlsdbUniqueCellId> *servingCellIds)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "no last location at" << fileName;
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    in >> magic >> version;
+    if (magic != LastLocationMagic || version != LastLocationVersion) {
+        qDebug() << "last location" << fileName << "format unknown:" << magic << version;
+        return false;
+    }
+
+    qint64 timestamp = 0;
+    double latitude = 0.0, longitude = 0.0, accuracy = 0.0;
+    QList<MlsdbUniqueCellId> cellIds;
+    in >> timestamp >> latitude >> longitude >> accuracy >> cellIds;
+    if (in.status() != QDataStream::Ok || timestamp == 0) {
+        qDebug() << "last location" << fileName << "is truncated";
+        return false;
+    }
+
+    Accuracy positionAccuracy;
+    positionAccuracy.setHorizontal(accuracy);
+    location->setTimestamp(timestamp);
+    location->setLatitude(latitude);
+    location->setLongitude(longitude);
+    location->setAccuracy(positionAccuracy);
+    *servingCellIds = cellIds;
+    return true;
+}
+
+bool LastLocationStore::save(const QString &fileName, const Location &location,
+                             const QList<MlsdbUniqueCellId> &servingCellIds)
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "unable to write last location" << fileName << ":" << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << LastLocationMagic << LastLocationVersion
+        << location.timestamp() << location.latitude() << location.longitude()
+        << location.accuracy().horizontal() << servingCellIds;
+
+    if (!file.commit()) {
+        qWarning() << "unable to write last location" << fileName << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
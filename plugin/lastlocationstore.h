@@ -0,0 +1,36 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef LASTLOCATIONSTORE_H
+#define LASTLOCATIONSTORE_H
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include "locationtypes.h"
+#include "mlsdbserialisation.h"
+
+/*
+ * Persists the last position fix together with the cells the device was
+ * registered to at the time, so that the fix can be served as soon as the
+ * provider is activated again in the same cell.
+ */
+
+class LastLocationStore
+{
+public:
+    static bool load(const QString &fileName, Location *location,
+                     QList<MlsdbUniqueCellId> *servingCellIds);
+    static bool save(const QString &fileName, const Location &location,
+                     const QList<MlsdbUniqueCellId> &servingCellIds);
+};
+
+#endif // LASTLOCATIONSTORE_H
@@ -0,0 +1,320 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbcellcache.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtDebug>
+#include <QtCore/qmath.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+    const quint32 CellCacheMagic = 0x6d6c6363; // "mlcc"
+    const qint32 CellCacheVersion = 3;
+    const double CoordScale = 10000000.0;       // coordinates are stored in 1e-7 degrees
+
+    int tableSizeFor(int maximumSize)
+    {
+        // keep the table at most half full so that probe sequences stay short.
+        int size = 16;
+        while (size < maximumSize * 2) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    quint64 slotHash(quint64 key, quint8 cellType)
+    {
+        return mlsdbMixHash(key ^ (quint64(cellType) << 60));
+    }
+}
+
+MlsdbCellCache::MlsdbCellCache(const QString &fileName, int maximumSize, qint64 unknownLocationTtl)
+    : m_fileName(fileName)
+    , m_unknownLocationTtl(unknownLocationTtl)
+    , m_maximumSize(qMax(1, maximumSize))
+    , m_slots(tableSizeFor(m_maximumSize))
+    , m_size(0)
+    , m_clock(0)
+    , m_loaded(false)
+    , m_dirty(false)
+{
+}
+
+MlsdbCellCache::~MlsdbCellCache()
+{
+}
+
+int MlsdbCellCache::findSlot(quint64 key, quint8 cellType) const
+{
+    // returns the slot holding the key, or the empty slot where it would be inserted.
+    const int mask = m_slots.size() - 1;
+    int index = int(slotHash(key, cellType) & mask);
+    while (m_slots.at(index).state != EmptySlot) {
+        const Slot &slot(m_slots.at(index));
+        if (slot.key == key && slot.cellType == cellType) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+MlsdbCellCache::Slot *MlsdbCellCache::insertSlot(const MlsdbUniqueCellId &uniqueCellId)
+{
+    quint64 key = 0;
+    if (!mlsdbPackCellId(uniqueCellId, &key)) {
+        qDebug() << "not caching cell id which cannot be packed:" << uniqueCellId.toString();
+        return 0;
+    }
+
+    const quint8 cellType = uniqueCellId.cellType();
+    int index = findSlot(key, cellType);
+    if (m_slots.at(index).state == EmptySlot) {
+        if (m_size >= m_maximumSize) {
+            evictLeastRecentlyUsed();
+            index = findSlot(key, cellType);
+        }
+        ++m_size;
+    }
+
+    Slot *slot = &m_slots[index];
+    slot->key = key;
+    slot->cellType = cellType;
+    slot->lastUsed = ++m_clock;
+    m_dirty = true;
+    return slot;
+}
+
+void MlsdbCellCache::removeSlot(int index)
+{
+    // backward shift deletion, so that no tombstones are needed.
+    const int mask = m_slots.size() - 1;
+    int hole = index;
+    int next = (hole + 1) & mask;
+    while (m_slots.at(next).state != EmptySlot) {
+        const Slot &slot(m_slots.at(next));
+        const int home = int(slotHash(slot.key, slot.cellType) & mask);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            m_slots[hole] = slot;
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    m_slots[hole].state = EmptySlot;
+    --m_size;
+}
+
+void MlsdbCellCache::evictLeastRecentlyUsed()
+{
+    // evict the least recently used eighth of the entries in one pass,
+    // so that the cost of a rebuild is amortised over many insertions.
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVector<quint32> ages;
+    ages.reserve(m_size);
+    for (int i = 0; i < m_slots.size(); ++i) {
+        const Slot &slot(m_slots.at(i));
+        if (slot.state != EmptySlot) {
+            ages.append(m_clock - slot.lastUsed);
+        }
+    }
+    const int evictCount = qMax(1, ages.size() / 8);
+    std::nth_element(ages.begin(), ages.begin() + (evictCount - 1), ages.end(), std::greater<quint32>());
+    const quint32 minimumEvictedAge = ages.at(evictCount - 1);
+
+    const QVector<Slot> oldSlots(m_slots);
+    m_slots.fill(Slot());
+    m_size = 0;
+    const int mask = m_slots.size() - 1;
+    for (int i = 0; i < oldSlots.size(); ++i) {
+        const Slot &slot(oldSlots.at(i));
+        if (slot.state == EmptySlot
+                || (m_clock - slot.lastUsed) >= minimumEvictedAge
+                || (slot.state == UnknownLocationSlot && slot.expiry < now)) {
+            continue;
+        }
+        int index = int(slotHash(slot.key, slot.cellType) & mask);
+        while (m_slots.at(index).state != EmptySlot) {
+            index = (index + 1) & mask;
+        }
+        m_slots[index] = slot;
+        ++m_size;
+    }
+    m_dirty = true;
+}
+
+MlsdbCellCache::Result MlsdbCellCache::lookup(const MlsdbUniqueCellId &uniqueCellId, MlsdbCoords *coords)
+{
+    loadIfNeeded();
+
+    quint64 key = 0;
+    if (!mlsdbPackCellId(uniqueCellId, &key)) {
+        return NotCached;
+    }
+
+    const int index = findSlot(key, uniqueCellId.cellType());
+    Slot &slot(m_slots[index]);
+    if (slot.state == EmptySlot) {
+        return NotCached;
+    }
+
+    if (slot.state == KnownLocationSlot) {
+        slot.lastUsed = ++m_clock;
+        coords->lat = slot.coords[0] / CoordScale;
+        coords->lon = slot.coords[1] / CoordScale;
+        return KnownLocation;
+    }
+
+    if (slot.expiry < QDateTime::currentMSecsSinceEpoch()) {
+        // the database may have been updated since, probe the cell again.
+        removeSlot(index);
+        m_dirty = true;
+        return NotCached;
+    }
+
+    slot.lastUsed = ++m_clock;
+    return UnknownLocation;
+}
+
+void MlsdbCellCache::insertLocation(const MlsdbUniqueCellId &uniqueCellId, const MlsdbCoords &coords)
+{
+    loadIfNeeded();
+
+    Slot *slot = insertSlot(uniqueCellId);
+    if (slot) {
+        slot->state = KnownLocationSlot;
+        slot->coords[0] = qRound(coords.lat * CoordScale);
+        slot->coords[1] = qRound(coords.lon * CoordScale);
+    }
+}
+
+void MlsdbCellCache::insertUnknownLocation(const MlsdbUniqueCellId &uniqueCellId)
+{
+    loadIfNeeded();
+
+    Slot *slot = insertSlot(uniqueCellId);
+    if (slot) {
+        slot->state = UnknownLocationSlot;
+        slot->expiry = QDateTime::currentMSecsSinceEpoch() + m_unknownLocationTtl;
+    }
+}
+
+void MlsdbCellCache::loadIfNeeded()
+{
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "no cell location cache at" << m_fileName;
+        return;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CellCacheMagic || version != CellCacheVersion) {
+        qDebug() << "cell location cache" << m_fileName << "format unknown:" << magic << version;
+        return;
+    }
+
+    // entries are stored least recently used first, so inserting them
+    // in order restores their relative recency.
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Slot stored;
+        in >> stored.key >> stored.state >> stored.cellType;
+        if (stored.state == KnownLocationSlot) {
+            in >> stored.coords[0] >> stored.coords[1];
+        } else if (stored.state == UnknownLocationSlot) {
+            in >> stored.expiry;
+        } else {
+            break; // the layout of the remaining entries is unknown
+        }
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+        if (stored.state == UnknownLocationSlot && stored.expiry < now) {
+            continue;
+        }
+        Slot *slot = insertSlot(mlsdbUnpackCellId(stored.key, static_cast<MlsdbCellType>(stored.cellType)));
+        if (slot) {
+            slot->state = stored.state;
+            if (stored.state == KnownLocationSlot) {
+                slot->coords[0] = stored.coords[0];
+                slot->coords[1] = stored.coords[1];
+            } else {
+                slot->expiry = stored.expiry;
+            }
+        }
+    }
+
+    m_dirty = false;
+    qDebug() << "loaded" << m_size << "cell locations from cache" << m_fileName;
+}
+
+bool MlsdbCellCache::save()
+{
+    if (!m_dirty) {
+        return true;
+    }
+
+    QVector<Slot> entries;
+    entries.reserve(m_size);
+    for (int i = 0; i < m_slots.size(); ++i) {
+        if (m_slots.at(i).state != EmptySlot) {
+            entries.append(m_slots.at(i));
+        }
+    }
+    const quint32 clock = m_clock;
+    std::sort(entries.begin(), entries.end(), [clock](const Slot &a, const Slot &b) {
+        return (clock - a.lastUsed) > (clock - b.lastUsed);
+    });
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "unable to write cell location cache" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+
+    // the coordinates and the expiry share storage, only the member in use is written.
+    QDataStream out(&file);
+    out << CellCacheMagic << CellCacheVersion << quint32(entries.size());
+    Q_FOREACH (const Slot &slot, entries) {
+        out << slot.key << slot.state << slot.cellType;
+        if (slot.state == KnownLocationSlot) {
+            out << slot.coords[0] << slot.coords[1];
+        } else {
+            out << slot.expiry;
+        }
+    }
+
+    if (!file.commit()) {
+        qWarning() << "unable to write cell location cache" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+
+    qDebug() << "saved" << entries.size() << "cell locations to cache" << m_fileName;
+    m_dirty = false;
+    return true;
+}
@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef MLSDBCELLCACHE_H
+#define MLSDBCELLCACHE_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "mlsdbserialisation.h"
+
+/*
+ * The MlsdbCellCache class remembers the result of previous database
+ * lookups, both cells with a known location and cells which are known
+ * to be missing from the database.  The cache is size-capped with least
+ * recently used eviction, unknown locations expire after a while, and
+ * the contents are persisted to disk so that they survive restarts.
+ *
+ * Entries are kept in a flat open-addressing (linear probing) table,
+ * keyed by the packed 64 bit cell id, with the coordinates stored
+ * inline as fixed-point integers.
+ */
+
+class MlsdbCellCache
+{
+public:
+    enum Result {
+        NotCached,
+        KnownLocation,
+        UnknownLocation
+    };
+
+    MlsdbCellCache(const QString &fileName, int maximumSize, qint64 unknownLocationTtl);
+    ~MlsdbCellCache();
+
+    Result lookup(const MlsdbUniqueCellId &uniqueCellId, MlsdbCoords *coords);
+    void insertLocation(const MlsdbUniqueCellId &uniqueCellId, const MlsdbCoords &coords);
+    void insertUnknownLocation(const MlsdbUniqueCellId &uniqueCellId);
+
+    int size() const { return m_size; }
+    bool isDirty() const { return m_dirty; }
+    bool save();
+
+private:
+    Q_DISABLE_COPY(MlsdbCellCache)
+
+    enum SlotState {
+        EmptySlot = 0,
+        KnownLocationSlot,
+        UnknownLocationSlot
+    };
+
+    struct Slot {
+        quint64 key;
+        union {
+            qint32 coords[2];   // latitude and longitude in 1e-7 degrees
+            qint64 expiry;      // msecs since epoch, for unknown locations
+        };
+        quint32 lastUsed;
+        quint8 state;
+        quint8 cellType;
+    };
+
+    int findSlot(quint64 key, quint8 cellType) const;
+    Slot *insertSlot(const MlsdbUniqueCellId &uniqueCellId);
+    void removeSlot(int index);
+    void evictLeastRecentlyUsed();
+    void loadIfNeeded();
+
+    QString m_fileName;
+    qint64 m_unknownLocationTtl;
+    int m_maximumSize;
+    QVector<Slot> m_slots;  // power of two size, at most half full
+    int m_size;
+    quint32 m_clock;
+    bool m_loaded;
+    bool m_dirty;
+};
+
+#endif // MLSDBCELLCACHE_H
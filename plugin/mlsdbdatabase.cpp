@@ -0,0 +1,311 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbdatabase.h"
+#include "mlsdbindexfile.h"
+#include "mlsdbbloomfilter.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QtDebug>
+#include <QtCore/QVector>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace {
+    const QString DataFileName = QStringLiteral("mlsdb.data");
+    const qint64 DataFileHeaderSize = 8; // quint32 magic, qint32 version
+}
+
+struct MlsdbDatabase::DataFile {
+    QString fileName;
+    qint32 version;
+    QFile file;             // MLSDB_DATA_VERSION_MAP, kept open between lookups
+    MlsdbIndexFile index;   // MLSDB_DATA_VERSION_INDEX, kept mapped between lookups
+    MlsdbBloomFilter filter; // invalid if the data file has no mlsdb.bloom
+};
+
+struct MlsdbDatabase::BucketSearch {
+    QList<QSharedPointer<DataFile> > dataFiles;
+    QList<MlsdbUniqueCellId> cellIds;       // not found yet
+    QMap<MlsdbUniqueCellId, MlsdbCoords> cellLocations;
+    FilterStatistics filterStatistics;
+};
+
+MlsdbDatabase::MlsdbDatabase(const QString &path, QObject *parent)
+    : QObject(parent)
+    , m_path(path)
+    , m_manifestValid(false)
+{
+    connect(&m_databaseWatcher, &QFileSystemWatcher::directoryChanged,
+            this, &MlsdbDatabase::databaseChanged);
+    connect(&m_databaseWatcher, &QFileSystemWatcher::fileChanged,
+            this, &MlsdbDatabase::databaseChanged);
+    buildManifest();
+}
+
+MlsdbDatabase::~MlsdbDatabase()
+{
+}
+
+void MlsdbDatabase::databaseChanged()
+{
+    if (m_manifestValid) {
+        qDebug() << "geoclue-mlsdb database" << m_path << "changed, manifest will be rebuilt";
+        m_manifestValid = false;
+    }
+}
+
+void MlsdbDatabase::buildManifest()
+{
+    m_buckets.clear();
+    m_shards.clear();
+    m_areas.clear();
+    if (!m_databaseWatcher.files().isEmpty()) {
+        m_databaseWatcher.removePaths(m_databaseWatcher.files());
+    }
+    if (!m_databaseWatcher.directories().isEmpty()) {
+        m_databaseWatcher.removePaths(m_databaseWatcher.directories());
+    }
+    m_manifestValid = true;
+
+    if (!QFileInfo(m_path).isDir()) {
+        qDebug() << "geoclue-mlsdb database directory" << m_path << "does not exist";
+        return;
+    }
+
+    // sharded databases are keyed by the shard path relative to the database directory,
+    // legacy databases by the name of the bucket directory.
+    const QDir databaseDir(m_path);
+    if (m_shards.load(databaseDir.filePath(QStringLiteral(MLSDB_MANIFEST_FILE_NAME)))) {
+        qDebug() << "geoclue-mlsdb database" << m_path << "is sharded per network";
+    }
+    if (m_areas.load(databaseDir.filePath(QStringLiteral(MLSDB_AREAS_FILE_NAME)))) {
+        qDebug() << "geoclue-mlsdb database" << m_path << "has an area centroid table";
+    }
+
+    // a sharded database holds thousands of files, watching each would exhaust the
+    // inotify watches.  every build rewrites the manifest and the area table, so
+    // they are watched along with the database directory.  a legacy database has
+    // no manifest, its few bucket directories are watched instead.
+    QStringList watchedPaths(m_path);
+    Q_FOREACH (const QString &fileName, QStringList() << QStringLiteral(MLSDB_MANIFEST_FILE_NAME)
+                                                      << QStringLiteral(MLSDB_AREAS_FILE_NAME)) {
+        if (databaseDir.exists(fileName)) {
+            watchedPaths.append(databaseDir.filePath(fileName));
+        }
+    }
+    if (m_shards.isEmpty()) {
+        Q_FOREACH (const QString &bucket, databaseDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            watchedPaths.append(databaseDir.filePath(bucket));
+        }
+    }
+
+    qint64 filterBytes = 0;
+    QDirIterator it(m_path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString fname(it.next());
+        const QFileInfo info(it.fileInfo());
+        if (info.fileName().compare(DataFileName, Qt::CaseInsensitive) != 0) {
+            continue;
+        }
+
+        QSharedPointer<DataFile> dataFile(new DataFile);
+        dataFile->fileName = fname;
+        dataFile->file.setFileName(fname);
+        if (!dataFile->file.open(QIODevice::ReadOnly)) {
+            qDebug() << "geoclue-mlsdb data file" << fname << "cannot be opened:" << dataFile->file.errorString();
+            continue;
+        }
+
+        QDataStream in(&dataFile->file);
+        quint32 magic = 0, expectedMagic = (quint32)MLSDB_DATA_MAGIC;
+        in >> magic;
+        if (magic != MLSDB_DATA_MAGIC) {
+            qDebug() << "geoclue-mlsdb data file" << fname << "format unknown:" << magic << "expected:" << expectedMagic;
+            continue; // ignore this file
+        }
+        in >> dataFile->version;
+        if (dataFile->version == MLSDB_DATA_VERSION_INDEX) {
+            // sorted fixed-width records, map the file and search it in place.
+            dataFile->file.close();
+            if (!dataFile->index.open(fname)) {
+                continue; // ignore this file
+            }
+        } else if (dataFile->version != MLSDB_DATA_VERSION_MAP) {
+            qDebug() << "geoclue-mlsdb data file" << fname << "version unknown:" << dataFile->version;
+            continue; // ignore this file
+        }
+
+        // the filter is small, keep it in memory so that definite misses never touch the data file.
+        const QString filterFileName = info.dir().filePath(QStringLiteral(MLSDB_BLOOM_FILE_NAME));
+        if (dataFile->filter.load(filterFileName)) {
+            filterBytes += dataFile->filter.sizeInBytes();
+        }
+
+        m_buckets.insert(m_shards.isEmpty() ? info.dir().dirName()
+                                            : databaseDir.relativeFilePath(info.absolutePath()),
+                         dataFile);
+    }
+
+    m_databaseWatcher.addPaths(watchedPaths);
+    qDebug() << "geoclue-mlsdb database" << m_path << "manifest contains" << m_buckets.size() << "data files,"
+             << filterBytes << "bytes of bloom filters";
+}
+
+void MlsdbDatabase::lookup(const QList<MlsdbUniqueCellId> &cellIds,
+                           QMap<MlsdbUniqueCellId, MlsdbCoords> *cellLocations)
+{
+    if (!m_manifestValid) {
+        buildManifest();
+    }
+
+    // group the cells by bucket so that each data file is read at most once per scan.
+    QMap<QString, QList<MlsdbUniqueCellId> > bucketCellIds;
+    Q_FOREACH (const MlsdbUniqueCellId &uniqueCellId, cellIds) {
+        const QString bucket = m_shards.isEmpty() ? mlsdbBucketForCellId(uniqueCellId)
+                                                  : m_shards.shardForCellId(uniqueCellId);
+        if (bucket.isEmpty()) {
+            qDebug() << "geoclue-mlsdb database contains no cells of the network of composed cell id:" << uniqueCellId.toString();
+            continue;
+        }
+        QList<MlsdbUniqueCellId> &ids(bucketCellIds[bucket]);
+        if (!ids.contains(uniqueCellId)) {
+            ids.append(uniqueCellId);
+        }
+    }
+
+    QVector<BucketSearch> searches;
+    searches.reserve(bucketCellIds.size());
+    QMap<QString, QList<MlsdbUniqueCellId> >::const_iterator bucket = bucketCellIds.constBegin();
+    for (; bucket != bucketCellIds.constEnd(); ++bucket) {
+        BucketSearch search;
+        search.dataFiles = m_buckets.values(bucket.key());
+        search.cellIds = bucket.value();
+        searches.append(search);
+    }
+
+    // the buckets are independent files, search them in parallel if there are several.
+    if (searches.size() > 1) {
+        QtConcurrent::blockingMap(searches, &MlsdbDatabase::searchBucket);
+    } else if (searches.size() == 1) {
+        searchBucket(searches[0]);
+    }
+
+    Q_FOREACH (const BucketSearch &search, searches) {
+        QMap<MlsdbUniqueCellId, MlsdbCoords>::const_iterator it = search.cellLocations.constBegin();
+        for (; it != search.cellLocations.constEnd(); ++it) {
+            cellLocations->insert(it.key(), it.value());
+        }
+        m_filterStatistics.rejected += search.filterStatistics.rejected;
+        m_filterStatistics.passed += search.filterStatistics.passed;
+        m_filterStatistics.falsePositives += search.filterStatistics.falsePositives;
+    }
+
+    qDebug() << "geoclue-mlsdb bloom filters rejected" << m_filterStatistics.rejected << "and passed"
+             << m_filterStatistics.passed << "lookups, of which" << m_filterStatistics.falsePositives
+             << "were false positives";
+}
+
+bool MlsdbDatabase::lookupArea(const MlsdbUniqueCellId &uniqueCellId,
+                               MlsdbAreaLocation *location, MlsdbAreaTable::Level *level)
+{
+    if (!m_manifestValid) {
+        buildManifest();
+    }
+
+    return m_areas.lookup(uniqueCellId, location, level);
+}
+
+void MlsdbDatabase::searchBucket(BucketSearch &search)
+{
+    Q_FOREACH (const QSharedPointer<DataFile> &dataFile, search.dataFiles) {
+        if (search.cellIds.isEmpty()) {
+            break;
+        }
+
+        // only search the data file for the cells its bloom filter might contain.
+        QList<MlsdbUniqueCellId> candidates;
+        Q_FOREACH (const MlsdbUniqueCellId &uniqueCellId, search.cellIds) {
+            if (!dataFile->filter.isValid()) {
+                candidates.append(uniqueCellId);
+            } else if (dataFile->filter.mayContain(uniqueCellId)) {
+                candidates.append(uniqueCellId);
+                ++search.filterStatistics.passed;
+            } else {
+                ++search.filterStatistics.rejected;
+            }
+        }
+        if (candidates.isEmpty()) {
+            continue;
+        }
+
+        // found an mlsdb.data file which might contain the cell data.  search it.
+        const QList<MlsdbUniqueCellId> searched(candidates);
+        searchDataFile(dataFile.data(), &candidates, &search.cellLocations);
+        Q_FOREACH (const MlsdbUniqueCellId &uniqueCellId, searched) {
+            if (!candidates.contains(uniqueCellId)) {
+                search.cellIds.removeOne(uniqueCellId);
+            }
+        }
+        if (dataFile->filter.isValid()) {
+            search.filterStatistics.falsePositives += candidates.size();
+        }
+    }
+
+    Q_FOREACH (const MlsdbUniqueCellId &uniqueCellId, search.cellIds) {
+        qDebug() << "no geoclue-mlsdb data files contain the location of composed cell id:" << uniqueCellId.toString();
+    }
+}
+
+bool MlsdbDatabase::searchDataFile(DataFile *dataFile, QList<MlsdbUniqueCellId> *cellIds,
+                                   QMap<MlsdbUniqueCellId, MlsdbCoords> *cellLocations)
+{
+    if (dataFile->version == MLSDB_DATA_VERSION_INDEX) {
+        QList<MlsdbUniqueCellId>::iterator it = cellIds->begin();
+        while (it != cellIds->end()) {
+            MlsdbCoords coords;
+            if (dataFile->index.lookup(*it, &coords)) {
+                qDebug() << "geoclue-mlsdb data file" << dataFile->fileName << "contains the location of composed cell id:" << it->toString() << "->" << coords.lat << "," << coords.lon;
+                cellLocations->insert(*it, coords);
+                it = cellIds->erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return true;
+    }
+
+    if (!dataFile->file.seek(DataFileHeaderSize)) {
+        qDebug() << "geoclue-mlsdb data file" << dataFile->fileName << "cannot be read:" << dataFile->file.errorString();
+        return false;
+    }
+
+    // walk the serialised map record by record rather than materialising it.
+    QDataStream in(&dataFile->file);
+    QMap<MlsdbUniqueCellId, MlsdbCoords> found;
+    const quint32 read = mlsdbStreamingLookup(in, cellIds, &found);
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "geoclue-mlsdb data file" << dataFile->fileName << "is corrupt after" << read << "cell locations";
+    }
+
+    QMap<MlsdbUniqueCellId, MlsdbCoords>::const_iterator it = found.constBegin();
+    for (; it != found.constEnd(); ++it) {
+        qDebug() << "geoclue-mlsdb data file" << dataFile->fileName << "contains the location of composed cell id:" << it.key().toString() << "->" << it.value().lat << "," << it.value().lon;
+        cellLocations->insert(it.key(), it.value());
+    }
+    if (!cellIds->isEmpty()) {
+        qDebug() << "geoclue-mlsdb data file" << dataFile->fileName << "searched" << read << "cell locations, but not for" << cellIds->size() << "cell ids";
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef MLSDBDATABASE_H
+#define MLSDBDATABASE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QMultiHash>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+
+#include "mlsdbserialisation.h"
+#include "mlsdbshardmanifest.h"
+#include "mlsdbareatable.h"
+
+/*
+ * The MlsdbDatabase class keeps a manifest of the offline cell
+ * location database: every mlsdb.data file found below the database
+ * directory is opened and its header validated once, and the open
+ * files are kept in a bucket key -> file table.  Buckets are either the
+ * per-network shards listed in the database's shard manifest, or the
+ * legacy location code buckets.  Data files which come with a bloom
+ * filter are only searched for the cells the filter might contain, and
+ * the buckets of a lookup are searched in parallel.  The area centroid
+ * table is kept in memory for coarse fallback positions.
+ *
+ * The manifest is rebuilt only when the database directory changes.
+ */
+
+class MlsdbDatabase : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct FilterStatistics {
+        FilterStatistics() : rejected(0), passed(0), falsePositives(0) {}
+        quint64 rejected;       // definite misses, the data file wasn't searched
+        quint64 passed;         // the data file was searched
+        quint64 falsePositives; // ... but didn't contain the cell
+    };
+
+    explicit MlsdbDatabase(const QString &path, QObject *parent = 0);
+    ~MlsdbDatabase();
+
+    FilterStatistics filterStatistics() const { return m_filterStatistics; }
+
+    void lookup(const QList<MlsdbUniqueCellId> &cellIds,
+                QMap<MlsdbUniqueCellId, MlsdbCoords> *cellLocations);
+    bool lookupArea(const MlsdbUniqueCellId &uniqueCellId,
+                    MlsdbAreaLocation *location, MlsdbAreaTable::Level *level);
+
+private Q_SLOTS:
+    void databaseChanged();
+
+private:
+    struct DataFile;
+    struct BucketSearch;
+
+    void buildManifest();
+    static void searchBucket(BucketSearch &search);
+    static bool searchDataFile(DataFile *dataFile, QList<MlsdbUniqueCellId> *cellIds,
+                        QMap<MlsdbUniqueCellId, MlsdbCoords> *cellLocations);
+
+    QString m_path;
+    QFileSystemWatcher m_databaseWatcher;
+    MlsdbShardManifest m_shards;
+    MlsdbAreaTable m_areas;
+    QMultiHash<QString, QSharedPointer<DataFile> > m_buckets;
+    FilterStatistics m_filterStatistics;
+    bool m_manifestValid;
+};
+
+#endif // MLSDBDATABASE_H
@@ -0,0 +1,200 @@
+/*
+    Copyright (C) 2016 Jolla Ltd.
+    Contact: Chris Adams <chris.adams@jollamobile.com>
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbengine.h"
+#include "mlsdbdatabase.h"
+#include "lastlocationstore.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QMap>
+#include <QtCore/QtDebug>
+
+#include <algorithm>
+
+namespace {
+    const int MinimumCalculatedAccuracy = 2500; // 2500 metres - arbitrary but large, manual cell-based triangulation is error-prone.
+}
+
+MlsdbEngine::MlsdbEngine(const QString &databasePath, const QString &cellCacheFileName,
+                         int cellCacheSize, qint64 cellCacheUnknownTtl,
+                         const QString &lastLocationFileName)
+    : QObject(0)
+    , m_databasePath(databasePath)
+    , m_lastLocationFileName(lastLocationFileName)
+    , m_database(0)
+    , m_cellCache(cellCacheFileName, cellCacheSize, cellCacheUnknownTtl)
+{
+}
+
+MlsdbEngine::~MlsdbEngine()
+{
+    m_cellCache.save();
+}
+
+void MlsdbEngine::saveCellCache()
+{
+    m_cellCache.save();
+}
+
+void MlsdbEngine::saveLastLocation(const Location &location, const QList<MlsdbCellPositioningData> &cells)
+{
+    QList<MlsdbUniqueCellId> servingCellIds;
+    Q_FOREACH (const MlsdbCellPositioningData &cell, cells) {
+        if (cell.registered) {
+            servingCellIds.append(cell.uniqueCellId);
+        }
+    }
+    LastLocationStore::save(m_lastLocationFileName, location, servingCellIds);
+}
+
+void MlsdbEngine::calculateLocation(const QList<MlsdbCellPositioningData> &cells)
+{
+    if (!m_database) {
+        // the database watches the file system, so it must be created on this thread.
+        m_database = new MlsdbDatabase(m_databasePath, this);
+    }
+
+    // determine which cells we have an accurate location for, from MLSDB data.
+    // probe all of the cell ids we haven't encountered yet in a single pass.
+    QList<MlsdbUniqueCellId> unknownCellIds;
+    QMap<MlsdbUniqueCellId, MlsdbCoords> cellLocations;
+    Q_FOREACH (const MlsdbCellPositioningData &cell, cells) {
+        MlsdbCoords cellCoords;
+        switch (m_cellCache.lookup(cell.uniqueCellId, &cellCoords)) {
+        case MlsdbCellCache::KnownLocation:
+            cellLocations.insert(cell.uniqueCellId, cellCoords);
+            break;
+        case MlsdbCellCache::UnknownLocation:
+            // we know that we don't know the location of this cellId.  Skip it.
+            break;
+        case MlsdbCellCache::NotCached:
+            unknownCellIds.append(cell.uniqueCellId);
+            break;
+        }
+    }
+    if (!unknownCellIds.isEmpty()) {
+        QMap<MlsdbUniqueCellId, MlsdbCoords> foundLocations;
+        m_database->lookup(unknownCellIds, &foundLocations);
+        Q_FOREACH (const MlsdbUniqueCellId &uniqueCellId, unknownCellIds) {
+            if (foundLocations.contains(uniqueCellId)) {
+                // cache the location of the cell id for future reference.
+                m_cellCache.insertLocation(uniqueCellId, foundLocations.value(uniqueCellId));
+                cellLocations.insert(uniqueCellId, foundLocations.value(uniqueCellId));
+            } else {
+                // we now know that we don't know the location of this cellId.
+                m_cellCache.insertUnknownLocation(uniqueCellId);
+            }
+        }
+    }
+
+    double totalSignalStrength = 0.0;
+    Q_FOREACH (const MlsdbCellPositioningData &cell, cells) {
+        if (cellLocations.contains(cell.uniqueCellId)) {
+            totalSignalStrength += (1.0 * cell.signalStrength);
+        }
+    }
+
+    if (cellLocations.size() == 0) {
+        qDebug() << "no cell id data to calculate position from, falling back to area centroids";
+        emit locationCalculated(calculateAreaLocation(cells));
+        return;
+    } else if (cellLocations.size() == 1) {
+        qDebug() << "only one cell id datum to calculate position from, position will be extremely inaccurate";
+    } else if (cellLocations.size() == 2) {
+        qDebug() << "only two cell id data to calculate position from, position will be highly inaccurate";
+    } else {
+        qDebug() << "calculating position from" << cellLocations.size() << "cell id data";
+    }
+
+    // now use the current cell and neighboringcell information to triangulate our position.
+    double deviceLatitude = 0.0;
+    double deviceLongitude = 0.0;
+    Q_FOREACH (const MlsdbCellPositioningData &cell, cells) {
+        if (cellLocations.contains(cell.uniqueCellId)) {
+            const MlsdbCoords &cellCoords(cellLocations.value(cell.uniqueCellId));
+            double weight = (((double)cell.signalStrength) / totalSignalStrength);
+            deviceLatitude += (weight * cellCoords.lat);
+            deviceLongitude += (weight * cellCoords.lon);
+            qDebug() << "have cell:" << cell.uniqueCellId.toString()
+                                            << "with position:" << cellCoords.lat << "," << cellCoords.lon
+                                            << "with strength:" << ((double)cell.signalStrength / totalSignalStrength);
+        } else {
+            qDebug() << "do not know position of cell with id:" << cell.uniqueCellId.toString();
+        }
+    }
+
+    // estimate accuracy based on how many cells we have.
+    Location deviceLocation;
+    Accuracy positionAccuracy;
+    positionAccuracy.setHorizontal(qMax(MinimumCalculatedAccuracy,
+                                        10000 - (1000 * cellLocations.size())));
+    deviceLocation.setTimestamp(QDateTime::currentMSecsSinceEpoch());
+    deviceLocation.setLatitude(deviceLatitude);
+    deviceLocation.setLongitude(deviceLongitude);
+    deviceLocation.setAccuracy(positionAccuracy);
+    emit locationCalculated(deviceLocation);
+}
+
+Location MlsdbEngine::calculateAreaLocation(const QList<MlsdbCellPositioningData> &cells)
+{
+    // prefer the serving cells, then the strongest neighbours, and use
+    // the finest area any of them is known in.
+    QList<MlsdbCellPositioningData> candidates;
+    Q_FOREACH (const MlsdbCellPositioningData &cell, cells) {
+        if (cell.registered) {
+            candidates.append(cell);
+        }
+    }
+    QList<MlsdbCellPositioningData> neighbours;
+    Q_FOREACH (const MlsdbCellPositioningData &cell, cells) {
+        if (!cell.registered) {
+            neighbours.append(cell);
+        }
+    }
+    std::stable_sort(neighbours.begin(), neighbours.end(),
+                     [](const MlsdbCellPositioningData &a, const MlsdbCellPositioningData &b) {
+        return a.signalStrength > b.signalStrength;
+    });
+    candidates += neighbours;
+
+    MlsdbAreaLocation bestArea;
+    MlsdbAreaTable::Level bestLevel = MlsdbAreaTable::LevelCount;
+    Q_FOREACH (const MlsdbCellPositioningData &cell, candidates) {
+        MlsdbAreaLocation area;
+        MlsdbAreaTable::Level level;
+        if (m_database->lookupArea(cell.uniqueCellId, &area, &level) && level < bestLevel) {
+            qDebug() << "cell:" << cell.uniqueCellId.toString() << "is in a known"
+                     << MlsdbAreaTable::levelName(level) << "at:" << area.coords.lat << "," << area.coords.lon
+                     << "with radius:" << area.radius;
+            bestArea = area;
+            bestLevel = level;
+            if (level == MlsdbAreaTable::LocationCodeLevel) {
+                break;
+            }
+        }
+    }
+
+    if (bestLevel == MlsdbAreaTable::LevelCount) {
+        qDebug() << "no area data to calculate position from";
+        return Location();
+    }
+
+    Location deviceLocation;
+    Accuracy positionAccuracy;
+    positionAccuracy.setHorizontal(qMax<double>(MinimumCalculatedAccuracy, bestArea.radius));
+    deviceLocation.setTimestamp(QDateTime::currentMSecsSinceEpoch());
+    deviceLocation.setLatitude(bestArea.coords.lat);
+    deviceLocation.setLongitude(bestArea.coords.lon);
+    deviceLocation.setAccuracy(positionAccuracy);
+    return deviceLocation;
+}
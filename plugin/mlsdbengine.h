@@ -0,0 +1,77 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef MLSDBENGINE_H
+#define MLSDBENGINE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QList>
+#include <QtCore/QMetaType>
+#include <QtCore/QString>
+
+#include "locationtypes.h"
+#include "mlsdbserialisation.h"
+#include "mlsdbcellcache.h"
+
+class MlsdbDatabase;
+
+struct MlsdbCellPositioningData {
+    MlsdbUniqueCellId uniqueCellId;
+    quint32 signalStrength;
+    bool registered;        // the serving cell
+};
+Q_DECLARE_TYPEINFO(MlsdbCellPositioningData, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(MlsdbCellPositioningData)
+
+/*
+ * The MlsdbEngine class calculates the device position from a snapshot
+ * of the seen cells: the cell locations are looked up from the cell
+ * cache and the offline database, and the position is triangulated
+ * from them weighted by signal strength.  If none of the cells are in
+ * the database, a coarse position is given from the centroid of the
+ * location area, network or country of the serving cell.
+ *
+ * The engine lives on a worker thread, so that database I/O never blocks
+ * the D-Bus clients of the provider.  Cell snapshots are posted to it
+ * with calculateLocation(), and the result is posted back with
+ * locationCalculated(), which carries an invalid location if the
+ * position could not be determined.  The last fix is persisted on the
+ * worker thread too.
+ */
+
+class MlsdbEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    MlsdbEngine(const QString &databasePath, const QString &cellCacheFileName,
+                int cellCacheSize, qint64 cellCacheUnknownTtl,
+                const QString &lastLocationFileName);
+    ~MlsdbEngine();
+
+public Q_SLOTS:
+    void calculateLocation(const QList<MlsdbCellPositioningData> &cells);
+    void saveCellCache();
+    void saveLastLocation(const Location &location, const QList<MlsdbCellPositioningData> &cells);
+
+Q_SIGNALS:
+    void locationCalculated(const Location &location);
+
+private:
+    Location calculateAreaLocation(const QList<MlsdbCellPositioningData> &cells);
+
+    QString m_databasePath;
+    QString m_lastLocationFileName;
+    MlsdbDatabase *m_database; // created on the worker thread on first use
+    MlsdbCellCache m_cellCache;
+};
+
+#endif // MLSDBENGINE_H
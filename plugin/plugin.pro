@@ -5,7 +5,7 @@ TEMPLATE = app
 
 target.path = /usr/libexec
 
-QT = core dbus network
+QT = core concurrent dbus network
 
 CONFIG += link_pkgconfig
 PKGCONFIG += qofono-qt5 qofonoext connman-qt5 mlite5
@@ -22,7 +22,8 @@ packagesExist(qt5-boostable) {
 # not installed
 dbus_geoclue.files = \
     org.freedesktop.Geoclue.xml \
-    org.freedesktop.Geoclue.Position.xml
+    org.freedesktop.Geoclue.Position.xml \
+    org.freedesktop.Geoclue.Providers.Yandex.Geofence.xml
 dbus_geoclue.header_flags = "-l YandexProvider -i yandexprovider.h"
 dbus_geoclue.source_flags = "-l YandexProvider"
 
@@ -34,16 +35,36 @@ session_dbus_service.files = org.freedesktop.Geoclue.Providers.Yandex.service
 session_dbus_service.path = /usr/share/dbus-1/services
 geoclue_provider.files = geoclue-yandex.provider
 geoclue_provider.path = /usr/share/geoclue-providers
+position_feed_header.files = ../common/yandexpositionfeed.h
+position_feed_header.path = /usr/include/geoclue-yandex
 
 include (../common/common.pri)
 HEADERS += \
+    geofenceindex.h \
     yandexonlinelocator.h \
+    yandexpositionfeedwriter.h \
+    yandexrequestquota.h \
+    yandexresponsecache.h \
+    lastlocationstore.h \
     locationtypes.h \
+    radioenvironment.h \
+    mlsdbcellcache.h \
+    mlsdbdatabase.h \
+    mlsdbengine.h \
     yandexprovider.h
 
 SOURCES += \
+    geofenceindex.cpp \
+    lastlocationstore.cpp \
     main.cpp \
+    mlsdbcellcache.cpp \
+    mlsdbdatabase.cpp \
+    mlsdbengine.cpp \
+    radioenvironment.cpp \
     yandexonlinelocator.cpp \
+    yandexpositionfeedwriter.cpp \
+    yandexrequestquota.cpp \
+    yandexresponsecache.cpp \
     yandexprovider.cpp
 
 OTHER_FILES = \
@@ -51,4 +72,4 @@ OTHER_FILES = \
     $${session_dbus_service.files} \
     $${geoclue_provider.files}
 
-INSTALLS += target session_dbus_service geoclue_provider
+INSTALLS += target session_dbus_service geoclue_provider position_feed_header
@@ -0,0 +1,77 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "radioenvironment.h"
+
+#include <QtCore/qmath.h>
+
+RadioEnvironment::RadioEnvironment(double threshold, double strengthScale, double smoothing)
+    : m_threshold(threshold)
+    , m_strengthScale(qMax(1.0, strengthScale))
+    , m_smoothing(qBound(0.0, smoothing, 1.0))
+    , m_score(0.0)
+    , m_hasBaseline(false)
+{
+}
+
+void RadioEnvironment::reset()
+{
+    m_smoothed.clear();
+    m_baseline.clear();
+    m_score = 0.0;
+    m_hasBaseline = false;
+}
+
+bool RadioEnvironment::update(const QHash<QString, int> &strengths)
+{
+    // transmitters which just appeared start from their current strength,
+    // those which are gone are forgotten.
+    QHash<QString, double> smoothed;
+    for (QHash<QString, int>::const_iterator it = strengths.constBegin(); it != strengths.constEnd(); ++it) {
+        const QHash<QString, double>::const_iterator previous = m_smoothed.constFind(it.key());
+        smoothed.insert(it.key(), previous == m_smoothed.constEnd()
+                                ? double(it.value())
+                                : m_smoothing * it.value() + (1.0 - m_smoothing) * previous.value());
+    }
+    m_smoothed = smoothed;
+
+    if (!m_hasBaseline) {
+        m_baseline = m_smoothed;
+        m_hasBaseline = true;
+        m_score = m_smoothed.isEmpty() ? 0.0 : 1.0;
+        return m_score >= m_threshold;
+    }
+
+    int changed = 0; // entered or left
+    int seen = m_baseline.size();
+    double shift = 0.0;
+    for (QHash<QString, double>::const_iterator it = m_smoothed.constBegin(); it != m_smoothed.constEnd(); ++it) {
+        const QHash<QString, double>::const_iterator base = m_baseline.constFind(it.key());
+        if (base == m_baseline.constEnd()) {
+            ++changed;
+            ++seen;
+        } else {
+            shift += qMin(1.0, qAbs(it.value() - base.value()) / m_strengthScale);
+        }
+    }
+    for (QHash<QString, double>::const_iterator it = m_baseline.constBegin(); it != m_baseline.constEnd(); ++it) {
+        if (!m_smoothed.contains(it.key())) {
+            ++changed;
+        }
+    }
+
+    m_score = seen == 0 ? 0.0 : (changed + shift) / seen;
+    if (m_score < m_threshold) {
+        return false;
+    }
+    m_baseline = m_smoothed;
+    return true;
+}
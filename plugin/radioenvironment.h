@@ -0,0 +1,54 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef RADIOENVIRONMENT_H
+#define RADIOENVIRONMENT_H
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+
+/*
+ * The RadioEnvironment class detects meaningful changes of a set of
+ * radio transmitters (cells or access points) and their signal strengths.
+ *
+ * Signal strengths are smoothed with an exponentially weighted moving
+ * average, and every update is compared against the baseline, which is
+ * the environment at the last reported change.  The change score is the
+ * number of transmitters which entered or left, plus the smoothed
+ * strength shift of the others (relative to the strength scale and capped
+ * at one per transmitter), divided by the number of transmitters seen in
+ * either.  A score of at least the threshold is a change, and it becomes
+ * the new baseline.
+ */
+
+class RadioEnvironment
+{
+public:
+    RadioEnvironment(double threshold, double strengthScale, double smoothing);
+
+    bool update(const QHash<QString, int> &strengths);
+    void reset();
+
+    double score() const { return m_score; }
+    double threshold() const { return m_threshold; }
+    void setThreshold(double threshold) { m_threshold = threshold; }
+
+private:
+    double m_threshold;
+    double m_strengthScale;
+    double m_smoothing;
+    double m_score;
+    QHash<QString, double> m_smoothed;  // transmitters seen in the latest update
+    QHash<QString, double> m_baseline;  // ... and at the last change
+    bool m_hasBaseline;
+};
+
+#endif // RADIOENVIRONMENT_H
@@ -19,6 +19,7 @@
 #include <QtCore/QVariantMap>
 #include <QtCore/QTextStream>
 #include <QtCore/QDateTime>
+#include <QtCore/QStandardPaths>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkRequest>
 #include <QtNetwork/QNetworkReply>
@@ -39,6 +40,24 @@
 #define REQUEST_BASE_ADAPTIVE_INTERVAL 60000 /* 60 seconds */
 #define REQUEST_MODIFY_ADAPTIVE_INTERVAL 10000 /* 10 seconds */
 
+#define REQUEST_RETRY_ATTEMPTS 3
+#define REQUEST_RETRY_BASE_DELAY 2000 /* 2 seconds, doubled for every attempt */
+#define REQUEST_RETRY_MAXIMUM_DELAY 16000 /* 16 seconds */
+
+#define REQUEST_PREWARM_INTERVAL 30000 /* 30 seconds, idle connections are kept alive for longer than this */
+#define REQUEST_WLAN_CHANGE_SIMILARITY 0.6 /* Jaccard index below which the access points have changed */
+#define REQUEST_QUOTA_DAILY 1000 /* default, 0 for unlimited */
+#define REQUEST_QUOTA_BURST 10
+
+#define WLAN_CHANGE_THRESHOLD 0.25 /* change score of the access points which triggers a recalculation */
+#define WLAN_STRENGTH_SCALE 20 /* connman strength (0-100) shift which counts as much as an access point change */
+#define WLAN_STRENGTH_SMOOTHING 0.3 /* weight of the latest strength in the moving average */
+
+#define RESPONSE_CACHE_SIZE 256
+#define RESPONSE_CACHE_TTL (14LL * 24 * 60 * 60 * 1000) /* 14 days */
+#define RESPONSE_CACHE_SIMILARITY 0.6 /* Jaccard index of the access points */
+#define RESPONSE_CACHE_SAVE_DELAY 60000 /* 60 seconds */
+
 /*
  * HTTP requests are sent based on the Mozilla Location Services API.
  * See https://mozilla.github.io/ichnaea/api/geolocate.html for protocol documentation.
@@ -46,6 +65,16 @@
 
 namespace {
 const QString KeyFailureTimeKey(QStringLiteral("/mlsprovider/keyfailure_time"));
+const QString ResponseCacheFile(QStringLiteral("/geoclue-provider-yandex/onlinecache.data"));
+const QString MLSConfigFile(QStringLiteral("/etc/gps_xtra.ini"));
+const QString DefaultEndpoint(QStringLiteral("https://api.lbs.yandex.net/geolocation"));
+const char *const EndpointEnvironmentVariable = "GEOCLUE_YANDEX_ENDPOINT";
+
+quint32 configuredDailyQuota()
+{
+    QSettings settings(MLSConfigFile, QSettings::IniFormat);
+    return settings.value("MLS/DAILY_QUOTA", REQUEST_QUOTA_DAILY).toUInt();
+}
 
 QList<quint32> cellIdsFromQueryData(const QVariantMap &queryData)
 {
@@ -62,6 +91,27 @@ QList<quint32> cellIdsFromQueryData(const QVariantMap &queryData)
 
     return cellIds;
 }
+
+QSet<QString> bssidsFromQueryData(const QVariantMap &queryData)
+{
+    QSet<QString> bssids;
+
+    const QVariantList accessPoints = queryData.value(QLatin1String("wifiAccessPoints")).toList();
+    for (const QVariant &ap : accessPoints) {
+        bssids.insert(ap.toMap().value(QLatin1String("mac")).toString().toLower());
+    }
+
+    return bssids;
+}
+
+double bssidSimilarity(const QSet<QString> &a, const QSet<QString> &b)
+{
+    if (a.isEmpty() && b.isEmpty()) {
+        return 1.0;
+    }
+    const int shared = QSet<QString>(a).intersect(b).size();
+    return double(shared) / (a.size() + b.size() - shared);
+}
 }
 
 YandexOnlineLocator::YandexOnlineLocator(QObject *parent)
@@ -71,19 +121,42 @@ YandexOnlineLocator::YandexOnlineLocator(QObject *parent)
     , m_simManager(0)
     , m_networkManager(new NetworkManager(this))
     , m_currentReply(0)
+    , m_retryAttempt(0)
+    , m_timerWakeups(0)
+    , m_responseCache(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + ResponseCacheFile,
+                      RESPONSE_CACHE_SIZE, RESPONSE_CACHE_TTL, RESPONSE_CACHE_SIMILARITY)
     , m_fallbacksLacf(true)
     , m_fallbacksIpf(true)
     , m_wlanDataAllowed(true)
+    , m_wlanEnvironment(WLAN_CHANGE_THRESHOLD, WLAN_STRENGTH_SCALE, WLAN_STRENGTH_SMOOTHING)
     , m_adaptiveInterval(REQUEST_BASE_ADAPTIVE_INTERVAL)
     , m_keyFailureTime(KeyFailureTimeKey)
+    , m_quota(configuredDailyQuota(), REQUEST_QUOTA_BURST)
 {
-    QString MLSConfigFile = QStringLiteral("/etc/gps_xtra.ini");
     QSettings settings(MLSConfigFile, QSettings::IniFormat);
     m_fallbacksLacf = settings.value("MLS/FALLBACKS_LACF", true).toBool();
     m_fallbacksIpf = settings.value("MLS/FALLBACKS_IPF", true).toBool();
+    m_wlanEnvironment.setThreshold(settings.value("MLS/WLAN_CHANGE_THRESHOLD", WLAN_CHANGE_THRESHOLD).toDouble());
+
+    // the endpoint can be pointed at a local stand-in server for testing.
+    m_endpoint = QUrl(settings.value("MLS/ENDPOINT", DefaultEndpoint).toString());
+    if (qEnvironmentVariableIsSet(EndpointEnvironmentVariable)) {
+        m_endpoint = QUrl(QString::fromLocal8Bit(qgetenv(EndpointEnvironmentVariable)));
+    }
+    if (!m_endpoint.isValid()) {
+        qWarning() << "Invalid online endpoint" << m_endpoint << ", using" << DefaultEndpoint;
+        m_endpoint = QUrl(DefaultEndpoint);
+    }
+
+#ifndef QT_NO_SSL
+    // allow the TLS session to be resumed by later connections, which saves a round trip.
+    m_sslConfiguration = QSslConfiguration::defaultConfiguration();
+    m_sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+#endif
 
     qDebug() << "MLS_FALLBACKS_LACF" << m_fallbacksLacf
-                            << "MLS_FALLBACKS_IPF" << m_fallbacksIpf;
+                            << "MLS_FALLBACKS_IPF" << m_fallbacksIpf
+                            << "MLS_ENDPOINT" << m_endpoint;
 
     connect(m_nam, SIGNAL(finished(QNetworkReply*)), SLOT(requestOnlineLocationFinished(QNetworkReply*)));
     connect(m_modemManager, SIGNAL(enabledModemsChanged(QStringList)), SLOT(enabledModemsChanged(QStringList)));
@@ -92,17 +165,51 @@ YandexOnlineLocator::YandexOnlineLocator(QObject *parent)
     connect(&m_replyTimer, &QTimer::timeout, this, &YandexOnlineLocator::timeoutReply);
     m_replyTimer.setInterval(REQUEST_REPLY_TIMEOUT_INTERVAL);
     m_replyTimer.setSingleShot(true);
+    m_replyTimer.setTimerType(Qt::VeryCoarseTimer);
+    connect(&m_retryTimer, &QTimer::timeout, this, &YandexOnlineLocator::retryRequest);
+    m_retryTimer.setSingleShot(true);
+    m_retryTimer.setTimerType(Qt::CoarseTimer); // keep the back-off jitter, don't round it to whole seconds
+    qsrand(uint(QDateTime::currentMSecsSinceEpoch()));
+    connect(&m_responseCacheSaveTimer, &QTimer::timeout, this, &YandexOnlineLocator::saveResponseCache);
+    m_responseCacheSaveTimer.setInterval(RESPONSE_CACHE_SAVE_DELAY);
+    m_responseCacheSaveTimer.setSingleShot(true);
+    m_responseCacheSaveTimer.setTimerType(Qt::VeryCoarseTimer);
 }
 
 YandexOnlineLocator::~YandexOnlineLocator()
 {
+    m_responseCache.save();
+}
+
+void YandexOnlineLocator::saveResponseCache()
+{
+    ++m_timerWakeups;
+    m_responseCache.save();
+}
+
+quint32 YandexOnlineLocator::timerWakeups() const
+{
+    return m_timerWakeups;
 }
 
 void YandexOnlineLocator::networkServicesChanged()
 {
     if (m_wlanDataAllowed) {
         m_wlanServices = m_networkManager->getServices("wifi");
-        emit wlanChanged();
+
+        // connman reports every strength update, only report meaningful changes.
+        QHash<QString, int> strengths;
+        for (const QVariant &accessPoint : wlanAccessPointFields()) {
+            const QVariantMap fields = accessPoint.toMap();
+            strengths.insert(fields.value(QStringLiteral("mac")).toString().toLower(),
+                             fields.value(QStringLiteral("signal_strength")).toInt());
+        }
+        const bool changed = m_wlanEnvironment.update(strengths);
+        qDebug() << "wlan environment change score:" << m_wlanEnvironment.score()
+                 << "threshold:" << m_wlanEnvironment.threshold();
+        if (changed) {
+            emit wlanChanged();
+        }
     }
 }
 
@@ -134,6 +241,7 @@ void YandexOnlineLocator::setWlanDataAllowed(bool allowed)
         emit wlanChanged();
     } else if (!m_wlanDataAllowed) {
         m_wlanServices.clear();
+        m_wlanEnvironment.reset();
         emit wlanChanged();
     }
 }
@@ -146,7 +254,10 @@ QPair<QDateTime, QVariantMap> YandexOnlineLocator::buildLocationQuery(
     const QDateTime currDt = QDateTime::currentDateTimeUtc();
     QVariantMap map;
     map.unite(cellTowerFields(cells));
-//    map.unite(wlanAccessPointFields());
+    const QVariantList wlan = wlanAccessPointFields();
+    if (!wlan.isEmpty()) {
+        map["wifiAccessPoints"] = wlan;
+    }
 
     if (map.isEmpty()) {
         // no field data(cell, wifi) available
@@ -167,8 +278,10 @@ QPair<QDateTime, QVariantMap> YandexOnlineLocator::buildLocationQuery(
         const bool intervalExceeded = oldQuery.first.isNull() || oldQuery.first.msecsTo(currDt) >= m_adaptiveInterval;
         const bool moreInfo = map.keys().size() > oldQuery.second.keys().size();
         const bool newCells = cellIdsFromQueryData(oldQuery.second) != cellIdsFromQueryData(map);
+        const bool newWlan = bssidSimilarity(bssidsFromQueryData(oldQuery.second), bssidsFromQueryData(map))
+                           < REQUEST_WLAN_CHANGE_SIMILARITY;
 
-        if (firstTimeQuery || intervalExceeded || moreInfo || newCells) {
+        if (firstTimeQuery || intervalExceeded || moreInfo || newCells || newWlan) {
             // adaptively back-off future requests to avoid server-side throttling.
             static quint32 backOffFactor = 8;
 
@@ -196,7 +309,8 @@ QPair<QDateTime, QVariantMap> YandexOnlineLocator::buildLocationQuery(
                                               << "first:" << firstTimeQuery
                                               << "interval:" << intervalExceeded
                                               << "info:" << moreInfo
-                                              << "cells:" << newCells;
+                                              << "cells:" << newCells
+                                              << "wlan:" << newWlan;
                 m_queryTimestamps.prepend(QDateTime::currentMSecsSinceEpoch());
                 if (m_queryTimestamps.size() > REQUEST_TIMESTAMPS_TO_TRACK) {
                     m_queryTimestamps.removeLast();
@@ -213,17 +327,48 @@ QPair<QDateTime, QVariantMap> YandexOnlineLocator::buildLocationQuery(
     return qMakePair(QDateTime(), QVariantMap());
 }
 
-bool YandexOnlineLocator::findLocation()
+bool YandexOnlineLocator::findLocation(const QList<YandexProvider::CellPositioningData> &cells)
 {
-    if (!loadYandexKey()) {
-        qDebug() << "Unable to load Yandex API key";
-        return false;
+    QVariantList wlan = wlanAccessPointFields();
+    QStringList bssids;
+    for (const QVariant &accessPoint : wlan) {
+        bssids.append(accessPoint.toMap().value(QStringLiteral("mac")).toString());
     }
+    const QStringList cellKeyList = cellKeys(cells);
 
-    if (m_currentReply) {
+    // a request in progress (or waiting to be retried) for about the same
+    // radio environment will answer this one too.
+    if (m_currentReply && !fingerprintChanged(m_currentReply->property("bssids").toStringList(),
+                                              m_currentReply->property("cellKeys").toStringList(),
+                                              bssids, cellKeyList)) {
         qDebug() << "Previous request still in progress";
         return true;
     }
+    if (m_retryTimer.isActive() && !fingerprintChanged(m_retryBssids, m_retryCellKeys, bssids, cellKeyList)) {
+        qDebug() << "Previous request waiting to be retried";
+        return true;
+    }
+
+    // answer from previous responses for the same or a similar radio environment if possible.
+    YandexResponseCache::Position cached;
+    if (m_responseCache.lookup(bssids, cellKeyList, &cached)) {
+        qDebug() << "Using cached online response instead of sending a request";
+        cancelRequest();
+        QMetaObject::invokeMethod(this, "locationFound", Qt::QueuedConnection,
+                                  Q_ARG(double, cached.latitude),
+                                  Q_ARG(double, cached.longitude),
+                                  Q_ARG(double, cached.accuracy));
+        return true;
+    }
+
+    // from here on a stale request is only superseded if a new one can be
+    // sent, otherwise its answer is still better than none.
+    const bool pending = m_currentReply || m_retryTimer.isActive();
+
+    if (!loadYandexKey()) {
+        qDebug() << "Unable to load Yandex API key";
+        return pending;
+    }
 
     QString failureTimeString = m_keyFailureTime.value().toString();
 
@@ -235,13 +380,26 @@ bool YandexOnlineLocator::findLocation()
 
             if (diff >= 0 && diff < 12*60*60*1000) {
                 qDebug() << "Less than 12 hour old key failure, refusing a new try";
-                return false;
+                return pending;
             }
         }
     }
 
-    QNetworkRequest req(QUrl("http://api.lbs.yandex.net/geolocation"));
-    req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    // only send a request if the radio environment has changed enough, or the
+    // adaptive interval has passed, and the daily quota of the key allows it.
+    if (!m_quota.available()) {
+        qDebug() << "No online request quota left";
+        return pending;
+    }
+    const QPair<QDateTime, QVariantMap> query = buildLocationQuery(cells, m_previousQuery);
+    if (query.first.isNull() || !m_quota.acquire()) {
+        return pending;
+    }
+
+    if (pending) {
+        qDebug() << "Radio environment changed, superseding the previous request";
+        cancelRequest();
+    }
 
     QJsonObject doc;
 
@@ -250,7 +408,6 @@ bool YandexOnlineLocator::findLocation()
     common["api_key"] = m_yandexKey;
     doc.insert("common",common);
 
-    QVariantList wlan = wlanAccessPointFields();
     if(wlan.count() > 0) {
         QJsonArray wlanList;
         for (int i = 0; i < wlan.size(); i++) {
@@ -261,54 +418,181 @@ bool YandexOnlineLocator::findLocation()
 
     const QByteArray json = QJsonDocument(doc).toJson();
 
+    m_previousQuery = query;
+    m_retryAttempt = 0;
+    return sendRequest(json, bssids, cellKeyList);
+}
+
+bool YandexOnlineLocator::sendRequest(const QByteArray &json, const QStringList &bssids, const QStringList &cellKeys)
+{
+    QNetworkRequest req(m_endpoint);
+#ifndef QT_NO_SSL
+    if (m_endpoint.scheme() == QLatin1String("https")) {
+        req.setSslConfiguration(m_sslConfiguration);
+    }
+#endif
+    req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
     m_currentReply = m_nam->post(req, "json="+json);
     if (m_currentReply->error() != QNetworkReply::NoError) {
         qDebug() << "POST request failed:" << m_currentReply->errorString();
+        m_currentReply->deleteLater();
+        m_currentReply = 0;
         return false;
     }
+
+    // tag the reply with what it was built from, so that it can be
+    // superseded and its response cached for the right radio environment.
+    m_currentReply->setProperty("requestBody", json);
+    m_currentReply->setProperty("bssids", bssids);
+    m_currentReply->setProperty("cellKeys", cellKeys);
     m_replyTimer.start();
+    if (m_retryAttempt == 0) {
+        m_requestClock.start();
+    }
     qDebug() << "Sent request at:" << QDateTime::currentDateTimeUtc().toTime_t() << "with data:" << json;
     return true;
 }
 
+void YandexOnlineLocator::cancelRequest()
+{
+    m_retryTimer.stop();
+    m_retryAttempt = 0;
+    if (!m_currentReply) {
+        return;
+    }
+    QNetworkReply *reply = m_currentReply;
+    m_currentReply = 0;
+    m_replyTimer.stop();
+    reply->setProperty("superseded", QVariant::fromValue<bool>(true));
+    reply->abort(); // will emit finished, the finished slot will deleteLater().
+}
+
+bool YandexOnlineLocator::fingerprintChanged(const QStringList &oldBssids, const QStringList &oldCellKeys,
+                                             const QStringList &bssids, const QStringList &cellKeys)
+{
+    if (!oldBssids.isEmpty() || !bssids.isEmpty()) {
+        return bssidSimilarity(YandexResponseCache::normalisedBssids(oldBssids).toSet(),
+                               YandexResponseCache::normalisedBssids(bssids).toSet()) < REQUEST_WLAN_CHANGE_SIMILARITY;
+    }
+    return oldCellKeys.toSet() != cellKeys.toSet();
+}
+
+void YandexOnlineLocator::retryOrFail(const QString &errorString)
+{
+    const QByteArray json = m_currentReply->property("requestBody").toByteArray();
+    if (m_retryAttempt >= REQUEST_RETRY_ATTEMPTS || json.isEmpty()) {
+        m_retryAttempt = 0;
+        emit error(errorString);
+        return;
+    }
+
+    // exponential back-off with full jitter, so that devices which lost
+    // the connection at the same time don't retry in lockstep.
+    const int maximumDelay = qMin(REQUEST_RETRY_BASE_DELAY << m_retryAttempt, REQUEST_RETRY_MAXIMUM_DELAY);
+    const int delay = qrand() % (maximumDelay + 1);
+    ++m_retryAttempt;
+    qDebug() << "Request failed:" << errorString << ", retry" << m_retryAttempt << "in" << delay << "ms";
+
+    m_retryBody = json;
+    m_retryBssids = m_currentReply->property("bssids").toStringList();
+    m_retryCellKeys = m_currentReply->property("cellKeys").toStringList();
+    m_retryTimer.start(delay);
+}
+
+void YandexOnlineLocator::retryRequest()
+{
+    ++m_timerWakeups;
+    if (m_currentReply) {
+        return;
+    }
+    if (!m_quota.acquire()) {
+        qDebug() << "No online request quota left for retrying";
+        m_retryAttempt = 0;
+        emit error(QStringLiteral("request quota exhausted"));
+        return;
+    }
+    if (!sendRequest(m_retryBody, m_retryBssids, m_retryCellKeys)) {
+        m_retryAttempt = 0;
+        emit error(QStringLiteral("retrying the request failed"));
+    }
+}
+
+void YandexOnlineLocator::prewarmConnection()
+{
+    if (m_currentReply) {
+        return; // the connection is in use already
+    }
+    if (m_lastPrewarm.isValid() && m_lastPrewarm.elapsed() < REQUEST_PREWARM_INTERVAL) {
+        return;
+    }
+    if (!m_quota.available()) {
+        return; // no request could follow
+    }
+
+    // resolve the host and connect (and handshake) ahead of the request, the
+    // connection is kept alive by the access manager and used by the next post.
+    m_lastPrewarm.start();
+#ifndef QT_NO_SSL
+    if (m_endpoint.scheme() == QLatin1String("https")) {
+        qDebug() << "Pre-connecting to" << m_endpoint.host();
+        m_nam->connectToHostEncrypted(m_endpoint.host(), m_endpoint.port(443), m_sslConfiguration);
+        return;
+    }
+#endif
+    qDebug() << "Pre-connecting to" << m_endpoint.host();
+    m_nam->connectToHost(m_endpoint.host(), m_endpoint.port(80));
+}
+
 void YandexOnlineLocator::requestOnlineLocationFinished(QNetworkReply *reply)
 {
+    if (reply->property("superseded").toBool()) {
+        qDebug() << "Superseded request finished";
+        reply->deleteLater();
+        return;
+    }
     if (m_currentReply != reply) {
         qDebug() << "Received finished signal for unknown request reply!";
         return;
     }
+    m_replyTimer.stop();
 
     QString errorString;
     if (m_currentReply->property("timedOut").toBool()) {
-        emit error(QStringLiteral("manual timeout"));
+        retryOrFail(QStringLiteral("manual timeout"));
     } else {
         QByteArray data = m_currentReply->readAll();
 
         if (m_currentReply->error() == QNetworkReply::NoError) {
             m_keyFailureTime.unset();
+            m_retryAttempt = 0;
 
             qDebug() << "MLS response:" << data;
-            if (!readServerResponseData(data, &errorString)) {
+            if (!readServerResponseData(data, m_currentReply->property("bssids").toStringList(),
+                                        m_currentReply->property("cellKeys").toStringList(), &errorString)) {
                 emit error(errorString);
             }
-        } else {
-            checkError(data);
+        } else if (checkError(data)) {
+            m_retryAttempt = 0;
             emit error(m_currentReply->errorString());
+        } else {
+            retryOrFail(m_currentReply->errorString());
         }
     }
     m_currentReply->deleteLater();
     m_currentReply = 0;
-    m_replyTimer.stop();
 }
 
 void YandexOnlineLocator::timeoutReply()
 {
+    ++m_timerWakeups;
     qDebug() << "Request timed out at:" << QDateTime::currentDateTimeUtc().toTime_t();
     m_currentReply->setProperty("timedOut", QVariant::fromValue<bool>(true));
     m_currentReply->abort(); // will emit finished, the finished slot will deleteLater().
 }
 
-bool YandexOnlineLocator::readServerResponseData(const QByteArray &data, QString *errorString)
+bool YandexOnlineLocator::readServerResponseData(const QByteArray &data, const QStringList &bssids,
+                                                 const QStringList &cellKeys, QString *errorString)
 {
     QJsonParseError parseError;
     QJsonDocument json = QJsonDocument::fromJson(data, &parseError);
@@ -343,21 +627,31 @@ bool YandexOnlineLocator::readServerResponseData(const QByteArray &data, QString
     double accuracy = location["precision"].toDouble(&accuracyOk);
     if (!accuracyOk) {
         accuracy = -1;
+    } else {
+        YandexResponseCache::Position position;
+        position.latitude = latitude;
+        position.longitude = longitude;
+        position.accuracy = accuracy;
+        m_responseCache.insert(bssids, cellKeys, position);
+        if (!m_responseCacheSaveTimer.isActive()) {
+            m_responseCacheSaveTimer.start();
+        }
     }
+    qDebug() << "Time to fix:" << m_requestClock.elapsed() << "ms";
     emit locationFound(latitude, longitude, accuracy);
     return true;
 }
 
-void YandexOnlineLocator::checkError(const QByteArray &data)
+bool YandexOnlineLocator::checkError(const QByteArray &data)
 {
     QJsonParseError parseError;
     QJsonDocument json = QJsonDocument::fromJson(data, &parseError);
     if (parseError.error != QJsonParseError::NoError) {
-        return;
+        return false;
     }
 
     if (!json.isObject()) {
-        return;
+        return false;
     }
 
     int errorCode = json.object().value(QLatin1String("error")).toObject().value(QLatin1String("code")).toInt();
@@ -365,7 +659,9 @@ void YandexOnlineLocator::checkError(const QByteArray &data)
     if (errorCode == 400) {
         qWarning() << "Mozilla Location Service failed due to invalid API key, disabling the locator for 12 hours";
         m_keyFailureTime.set(QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+        return true;
     }
+    return false;
 }
 
 QVariantMap YandexOnlineLocator::globalFields() const
@@ -466,6 +762,20 @@ QVariantList YandexOnlineLocator::wlanAccessPointFields() const
     return wifiInfoList;
 }
 
+QStringList YandexOnlineLocator::cellKeys(const QList<YandexProvider::CellPositioningData> &cells)
+{
+    QStringList keys;
+    Q_FOREACH (const YandexProvider::CellPositioningData &cell, cells) {
+        keys.append(QStringLiteral("%1:%2:%3:%4:%5")
+                    .arg(cell.uniqueCellId.cellType())
+                    .arg(cell.uniqueCellId.mcc())
+                    .arg(cell.uniqueCellId.mnc())
+                    .arg(cell.uniqueCellId.locationCode())
+                    .arg(cell.uniqueCellId.cellId()));
+    }
+    return keys;
+}
+
 QVariantMap YandexOnlineLocator::fallbackFields() const
 {
     QVariantMap fallbacks;
@@ -18,10 +18,16 @@
 #include <QtCore/QList>
 #include <QtCore/QVector>
 #include <QtCore/QTimer>
+#include <QtCore/QUrl>
+#include <QtCore/QElapsedTimer>
+#include <QtNetwork/QSslConfiguration>
 
 #include <MGConfItem>
 
 #include "yandexprovider.h"
+#include "yandexresponsecache.h"
+#include "yandexrequestquota.h"
+#include "radioenvironment.h"
 
 QT_FORWARD_DECLARE_CLASS(QNetworkAccessManager)
 QT_FORWARD_DECLARE_CLASS(QNetworkReply)
@@ -50,7 +56,9 @@ public:
     QPair<QDateTime, QVariantMap> buildLocationQuery(
         const QList<YandexProvider::CellPositioningData> &cells,
         const QPair<QDateTime, QVariantMap> &oldQuery) const;
-    bool findLocation();
+    bool findLocation(const QList<YandexProvider::CellPositioningData> &cells);
+    void prewarmConnection();
+    quint32 timerWakeups() const;
 
 signals:
     void locationFound(double latitude, double longitude, double accuracy);
@@ -64,15 +72,24 @@ private Q_SLOTS:
     void defaultVoiceModemChanged(const QString &modem);
     void requestOnlineLocationFinished(QNetworkReply *reply);
     void timeoutReply();
+    void retryRequest();
+    void saveResponseCache();
 
 private:
-    bool readServerResponseData(const QByteArray &data, QString *errorString);
-    void checkError(const QByteArray &data);
+    bool sendRequest(const QByteArray &json, const QStringList &bssids, const QStringList &cellKeys);
+    void cancelRequest();
+    void retryOrFail(const QString &errorString);
+    static bool fingerprintChanged(const QStringList &oldBssids, const QStringList &oldCellKeys,
+                                   const QStringList &bssids, const QStringList &cellKeys);
+    bool readServerResponseData(const QByteArray &data, const QStringList &bssids,
+                                const QStringList &cellKeys, QString *errorString);
+    bool checkError(const QByteArray &data);
 
     QVariantMap globalFields() const;
     QVariantMap cellTowerFields(const QList<YandexProvider::CellPositioningData> &cells) const;
     QVariantMap fallbackFields() const;
     QVariantList wlanAccessPointFields() const;
+    static QStringList cellKeys(const QList<YandexProvider::CellPositioningData> &cells);
 
     void setupSimManager();
     bool loadYandexKey();
@@ -83,19 +100,37 @@ private:
     NetworkManager *m_networkManager;
     QNetworkReply *m_currentReply;
     QTimer m_replyTimer;
+    QTimer m_retryTimer;
+    int m_retryAttempt;
+    QByteArray m_retryBody;         // request waiting to be retried, and its fingerprint
+    QStringList m_retryBssids;
+    QStringList m_retryCellKeys;
+    quint32 m_timerWakeups;
+
+    YandexResponseCache m_responseCache;
+    QTimer m_responseCacheSaveTimer;
 
     QVector<NetworkService*> m_wlanServices;
     QString m_yandexKey;
+    QUrl m_endpoint;
+#ifndef QT_NO_SSL
+    QSslConfiguration m_sslConfiguration; // shared by all requests, so that connections and TLS sessions are reused
+#endif
+    QElapsedTimer m_lastPrewarm;
+    QElapsedTimer m_requestClock;   // since the first attempt of the current request, for the time to fix
 
     bool m_fallbacksLacf;
     bool m_fallbacksIpf;
 
     bool m_wlanDataAllowed;
+    RadioEnvironment m_wlanEnvironment;
 
     mutable quint32 m_adaptiveInterval;
     mutable QVector<qint64> m_queryTimestamps;
+    QPair<QDateTime, QVariantMap> m_previousQuery;
 
     MGConfItem m_keyFailureTime;
+    YandexRequestQuota m_quota;
 };
 
 #endif // MLSDBONLINELOCATOR_H
@@ -0,0 +1,102 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "yandexpositionfeedwriter.h"
+
+#include <QtCore/QtDebug>
+
+#include <errno.h>
+#include <string.h>
+
+YandexPositionFeedWriter::YandexPositionFeedWriter()
+    : m_data(0)
+{
+}
+
+YandexPositionFeedWriter::~YandexPositionFeedWriter()
+{
+    close();
+}
+
+bool YandexPositionFeedWriter::open()
+{
+    if (m_data) {
+        return true;
+    }
+
+    char name[64];
+    yandexPositionFeedName(name, sizeof(name));
+    const int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        qWarning() << "unable to open position feed" << name << ":" << strerror(errno);
+        return false;
+    }
+    void *data = MAP_FAILED;
+    // the position is private to the user, whatever the segment was created with before.
+    if (fchmod(fd, 0600) == 0 && ftruncate(fd, sizeof(YandexPositionFeedData)) == 0) {
+        data = mmap(0, sizeof(YandexPositionFeedData), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        qWarning() << "unable to map position feed" << name << ":" << strerror(error);
+        return false;
+    }
+
+    // a segment left behind by a previous instance is taken over, so that
+    // its readers keep working.  a new one is all zeroes.
+    m_data = static_cast<YandexPositionFeedData *>(data);
+    if (m_data->magic != YANDEX_POSITION_FEED_MAGIC || m_data->version != YANDEX_POSITION_FEED_VERSION) {
+        m_data->sequence.store(0, std::memory_order_relaxed);
+        m_data->words[YandexPositionFeedGeneration].store(0, std::memory_order_relaxed);
+        m_data->magic = YANDEX_POSITION_FEED_MAGIC;
+        m_data->version = YANDEX_POSITION_FEED_VERSION;
+    } else if (m_data->sequence.load(std::memory_order_relaxed) & 1) {
+        // the previous instance died while writing.
+        m_data->sequence.fetch_add(1, std::memory_order_release);
+    }
+    publish(Location(), 0);
+    qDebug() << "publishing the position to" << name;
+    return true;
+}
+
+void YandexPositionFeedWriter::close()
+{
+    if (!m_data) {
+        return;
+    }
+    publish(Location(), 0);
+    munmap(m_data, sizeof(YandexPositionFeedData));
+    m_data = 0;
+}
+
+void YandexPositionFeedWriter::publish(const Location &location, int fields)
+{
+    if (!m_data) {
+        return;
+    }
+
+    const quint32 sequence = m_data->sequence.load(std::memory_order_relaxed);
+    m_data->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::atomic<quint32> &generation(m_data->words[YandexPositionFeedGeneration]);
+    generation.store(generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    yandexPositionFeedStore(m_data, YandexPositionFeedTimestamp, quint64(location.timestamp()));
+    m_data->words[YandexPositionFeedFields].store(quint32(fields), std::memory_order_relaxed);
+    yandexPositionFeedStoreDouble(m_data, YandexPositionFeedLatitude, location.latitude());
+    yandexPositionFeedStoreDouble(m_data, YandexPositionFeedLongitude, location.longitude());
+    yandexPositionFeedStoreDouble(m_data, YandexPositionFeedAltitude, location.altitude());
+    yandexPositionFeedStoreDouble(m_data, YandexPositionFeedHorizontalAccuracy, location.accuracy().horizontal());
+    yandexPositionFeedStoreDouble(m_data, YandexPositionFeedVerticalAccuracy, location.accuracy().vertical());
+
+    m_data->sequence.store(sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,40 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef YANDEXPOSITIONFEEDWRITER_H
+#define YANDEXPOSITIONFEEDWRITER_H
+
+#include "yandexpositionfeed.h"
+#include "locationtypes.h"
+
+/*
+ * The YandexPositionFeedWriter class publishes the current fix to the
+ * shared memory position feed, see yandexpositionfeed.h.  The segment is
+ * only accessible to the user the provider runs as, readers map it read only.
+ */
+
+class YandexPositionFeedWriter
+{
+public:
+    YandexPositionFeedWriter();
+    ~YandexPositionFeedWriter();
+
+    bool open();
+    void close();
+    void publish(const Location &location, int fields);
+
+private:
+    Q_DISABLE_COPY(YandexPositionFeedWriter)
+
+    YandexPositionFeedData *m_data;
+};
+
+#endif // YANDEXPOSITIONFEEDWRITER_H
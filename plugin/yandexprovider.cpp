@@ -14,18 +14,22 @@
 #include "yandexprovider.h"
 
 #include "yandexonlinelocator.h"
+#include "lastlocationstore.h"
 #include "geoclue_adaptor.h"
 #include "position_adaptor.h"
+#include "geofence_adaptor.h"
 
 #include <QtGlobal>
+#include <QtCore/QCoreApplication>
 #include <QtCore/QFile>
-#include <QtCore/QDir>
-#include <QtCore/QDirIterator>
-#include <QtCore/QFileInfoList>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QStandardPaths>
 #include <QtCore/QList>
+#include <QtCore/QMetaObject>
 #include <QtDBus/QDBusConnection>
 #include <QtDBus/QDBusMessage>
+#include <QtCore/qmath.h>
+#include <QtCore/qnumeric.h>
 
 #include <qofonoextcellwatcher.h>
 
@@ -34,12 +38,36 @@
 
 namespace {
     YandexProvider *staticProvider = 0;
-    const int MinimumCalculatedAccuracy = 2500; // 2500 metres - arbitrary but large, manual cell-based triangulation is error-prone.
     const int QuitIdleTime = 30000;             // 30s, plugin process will kill itself if no clients request position updates in this time
     const int FixTimeout = 30000;               // 30s, status will change from Available to Acquiring if no position update can be calculated in this time since last update.
     const quint32 MinimumInterval = 10000;      // 10s, the shortest interval at which the plugin will recalculate position since last update
     const quint32 ReuseInterval = 30000;        // 30s, the amount of time a previously calculated position updates will be re-used for without recalculating new position
     const quint32 FallbackInterval = 120000;    // 120s, the amount of time a previously calculated position update with high accuracy can supercede a newly calculated low-accuracy position
+    const int CellCacheSize = 4096;             // the number of cell lookup results which are remembered
+    const qint64 CellCacheUnknownTtl = 86400000; // 24h, cells missing from the database are probed again after this time
+    const int CellCacheSaveInterval = 300000;   // 5min, the interval at which modified cell lookup results are written to disk
+    const int DelayedReplyTimeout = 20000;      // 20s, GetPosition callers waiting for the first fix get an empty reply after this time, within the D-Bus default timeout
+    const double DeliveryMinimumMovement = 25.0; // m, smaller moves of the position are not delivered to clients...
+    const double DeliveryAccuracyChange = 0.2;  // ... unless the accuracy changed by more than this fraction
+    const double EarthRadius = 6371000.0;       // m
+    const QString PositionObjectPath = QStringLiteral("/org/freedesktop/Geoclue/Providers/Yandex");
+    const QString PositionInterface = QStringLiteral("org.freedesktop.Geoclue.Position");
+    const QString GeofenceInterface = QStringLiteral("org.freedesktop.Geoclue.Providers.Yandex.Geofence");
+    const int MaximumGeofences = 1000;          // per service
+    const int MaximumGeofenceVertices = 1000;
+    const double MaximumGeofenceRadius = 1000000.0; // m
+    const int WakeupReportInterval = 100;       // the number of timer wakeups after which their count is logged
+    const QString MlsdbDatabaseDir = QStringLiteral("/usr/share/geoclue-provider-mlsdb/");
+    const QString CellCacheFile = QStringLiteral("/geoclue-provider-yandex/cellcache.data");
+    const QString LastLocationFile = QStringLiteral("/geoclue-provider-yandex/lastlocation.data");
+    const qint64 WarmStartMaximumAge = 86400000; // 24h, older persisted fixes are not served on activation
+    const double WarmStartDriftSpeed = 1.5;      // m/s, the accuracy of a persisted fix degrades at walking speed...
+    const double WarmStartMaximumAccuracy = 10000.0; // ... up to the size of a large cell, as the serving cell hasn't changed
+    const double CellChangeThreshold = 0.25;    // change score of the seen cells which triggers a recalculation
+    const double CellStrengthScale = 10.0;      // a smoothed signal strength shift this large counts as much as a cell change
+    const double CellStrengthSmoothing = 0.3;   // weight of the latest signal strength in the moving average
+    const QString MlsConfigFile = QStringLiteral("/etc/gps_xtra.ini");
+    const QString MlsConfigCellChangeThresholdKey = QStringLiteral("MLS/CELL_CHANGE_THRESHOLD");
     const QString LocationSettingsDir = QStringLiteral("/etc/location/");
     const QString LocationSettingsFile = QStringLiteral("/etc/location/location.conf");
     const QString LocationSettingsEnabledKey = QStringLiteral("location/enabled");
@@ -82,11 +110,22 @@ YandexProvider::YandexProvider(QObject *parent)
     m_cellDataAllowed(false),
     m_positioningStarted(false),
     m_status(StatusUnavailable),
+    m_lastSavedTimestamp(0),
+    m_lastCalculationTime(0),
+    m_recalculationDue(0),
+    m_timerWakeups(0),
     m_mlsdbOnlineLocator(0),
     m_onlinePositioningEnabled(false),
     m_onlineDataAllowed(false),
     m_wlanDataAllowed(false),
     m_cellWatcher(Q_NULLPTR),
+    m_cellEnvironment(CellChangeThreshold, CellStrengthScale, CellStrengthSmoothing),
+    m_engine(new MlsdbEngine(MlsdbDatabaseDir,
+                             QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + CellCacheFile,
+                             CellCacheSize, CellCacheUnknownTtl,
+                             QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + LastLocationFile)),
+    m_offlineCalculationPending(false),
+    m_offlineCalculationQueued(false),
     m_signalUpdateCell(false),
     m_signalUpdateWlan(false)
 {
@@ -94,9 +133,31 @@ YandexProvider::YandexProvider(QObject *parent)
         qFatal("Only a single instance of MlsdbProvider is supported.");
 
     qRegisterMetaType<Location>();
+    qRegisterMetaType<QList<MlsdbCellPositioningData> >();
     qDBusRegisterMetaType<Accuracy>();
 
     staticProvider = this;
+    m_wakeupClock.start();
+
+    QSettings mlsConfig(MlsConfigFile, QSettings::IniFormat);
+    m_cellEnvironment.setThreshold(mlsConfig.value(MlsConfigCellChangeThresholdKey, CellChangeThreshold).toDouble());
+
+    // high frequency readers get the position from shared memory instead of GetPosition.
+    m_positionFeed.open();
+
+    // database lookups and triangulation happen on the engine thread.
+    m_engine->moveToThread(&m_engineThread);
+    connect(&m_engineThread, &QThread::finished,
+            m_engine, &QObject::deleteLater);
+    connect(m_engine, &MlsdbEngine::locationCalculated,
+            this, &YandexProvider::offlineLocationCalculated);
+    m_engineThread.setObjectName(QStringLiteral("MlsdbEngine"));
+    m_engineThread.start();
+
+    if (LastLocationStore::load(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + LastLocationFile,
+                                &m_warmStartLocation, &m_warmStartCellIds)) {
+        m_lastSavedTimestamp = m_warmStartLocation.timestamp();
+    }
 
     connect(&m_locationSettingsWatcher, &QFileSystemWatcher::fileChanged,
             this, &YandexProvider::updatePositioningEnabled);
@@ -108,10 +169,11 @@ YandexProvider::YandexProvider(QObject *parent)
 
     new GeoclueAdaptor(this);
     new PositionAdaptor(this);
+    new GeofenceAdaptor(this);
 
     qDebug() << "Yandex Location Services geoclue plugin active";
-    if (m_watchedServices.isEmpty()) {
-        m_idleTimer.start(QuitIdleTime, this);
+    if (!hasPositioningUsers()) {
+        m_idleTimer.start(QuitIdleTime, Qt::VeryCoarseTimer, this);
     }
 
     QDBusConnection connection = QDBusConnection::sessionBus();
@@ -130,63 +192,20 @@ YandexProvider::YandexProvider(QObject *parent)
 
 YandexProvider::~YandexProvider()
 {
+    // the engine saves its cell cache when it is deleted at the end of the thread.
+    m_engineThread.quit();
+    m_engineThread.wait();
+
     if (staticProvider == this)
         staticProvider = 0;
 }
 
-/* TODO: coalesce lookups to avoid unnecessary repeated file I/O */
-bool YandexProvider::searchForCellIdLocation(const MlsdbUniqueCellId &uniqueCellId, MlsdbCoords *coords)
-{
-    // try to find the mlsdb data file which should contain it.
-    // the mlsdb data files are separated into "first digit of location code" directories/buckets.
-    QChar firstDigitAreaCode = QString::number(uniqueCellId.locationCode()).at(0);
-    QDirIterator it("/usr/share/geoclue-provider-mlsdb/", QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        const QString fname(it.next());
-        if (fname.endsWith(QStringLiteral("/%1/mlsdb.data").arg(firstDigitAreaCode), Qt::CaseInsensitive)) {
-            // found an mlsdb.data file which might contain the cell data.  search it.
-            QFile file(fname);
-            file.open(QIODevice::ReadOnly);
-            QDataStream in(&file);
-            quint32 magic = 0, expectedMagic = (quint32)0xc710cdb;
-            in >> magic;
-            if (magic != 0xc710cdb) {
-                qDebug() << "geoclue-mlsdb data file" << fname << "format unknown:" << magic << "expected:" << expectedMagic;
-                continue; // ignore this file
-            }
-            qint32 version;
-            in >> version;
-            if (version != 3) {
-                qDebug() << "geoclue-mlsdb data file" << fname << "version unknown:" << version;
-                continue; // ignore this file
-            }
-
-            QMap<MlsdbUniqueCellId, MlsdbCoords> perLcCellIdToLocations;
-            in >> perLcCellIdToLocations;
-            if (perLcCellIdToLocations.isEmpty()) {
-                qDebug() << "geoclue-mlsdb data file" << fname << "contained no cell locations!";
-            } else {
-                if (perLcCellIdToLocations.contains(uniqueCellId)) {
-                    *coords = perLcCellIdToLocations.value(uniqueCellId);
-                    qDebug() << "geoclue-mlsdb data file" << fname << "contains the location of composed cell id:" << uniqueCellId.toString() << "->" << coords->lat << "," << coords->lon;
-                    return true; // found!
-                } else {
-                    qDebug() << "geoclue-mlsdb data file" << fname << "contains" << perLcCellIdToLocations.size() << "cell locations, but not for:" << uniqueCellId.toString();
-                }
-            }
-        }
-    }
-
-    qDebug() << "no geoclue-mlsdb data files contain the location of composed cell id:" << uniqueCellId.toString();
-    return false;
-}
-
 void YandexProvider::AddReference()
 {
     if (!calledFromDBus())
         qFatal("AddReference must only be called from DBus");
 
-    bool wasInactive = m_watchedServices.isEmpty();
+    bool wasInactive = !hasPositioningUsers();
     const QString service = message().service();
     m_watcher->addWatchedService(service);
     m_watchedServices[service].referenceCount += 1;
@@ -209,13 +228,15 @@ void YandexProvider::RemoveReference()
         m_watchedServices[service].referenceCount -= 1;
 
     if (m_watchedServices[service].referenceCount == 0) {
-        m_watcher->removeWatchedService(service);
+        if (m_geofences.count(service) == 0) {
+            m_watcher->removeWatchedService(service);
+        }
         m_watchedServices.remove(service);
     }
 
-    if (m_watchedServices.isEmpty()) {
+    if (!hasPositioningUsers()) {
         qDebug() << "no watched services, starting idle timer.";
-        m_idleTimer.start(QuitIdleTime, this);
+        m_idleTimer.start(QuitIdleTime, Qt::VeryCoarseTimer, this);
     }
 
     stopPositioningIfNeeded();
@@ -247,14 +268,39 @@ void YandexProvider::SetOptions(const QVariantMap &options)
         m_watchedServices[service].updateInterval =
             options.value(QStringLiteral("UpdateInterval")).toUInt();
 
-        quint32 updateInterval = minimumRequestedUpdateInterval();
-        m_recalculatePositionTimer.start(updateInterval, this);
+        // the deadline may have moved either way.
+        m_recalculatePositionTimer.stop();
+        scheduleRecalculation(m_lastCalculationTime + minimumRequestedUpdateInterval());
+        if (m_signalUpdateCell || m_signalUpdateWlan) {
+            requestRecalculation();
+        }
+    }
+
+    if (options.contains(QStringLiteral("WaitForFix"))) {
+        m_watchedServices[service].waitForFix =
+            options.value(QStringLiteral("WaitForFix")).toBool();
     }
 }
 
 int YandexProvider::GetPosition(int &timestamp, double &latitude, double &longitude,
                                 double &altitude, Accuracy &accuracy)
 {
+    if (m_currentLocation.timestamp() == 0 && calledFromDBus() && m_positioningStarted
+            && m_watchedServices.value(message().service()).waitForFix) {
+        // reply once the first fix is known, all waiting callers share
+        // the calculation which is in flight.
+        qDebug() << "GetPosition: no valid current location known, replying once calculated";
+        setDelayedReply(true);
+        if (m_pendingPositionReplies.isEmpty()) {
+            m_positionReplyTimer.start(DelayedReplyTimeout, Qt::VeryCoarseTimer, this);
+            if (!m_offlineCalculationPending) {
+                requestRecalculation();
+            }
+        }
+        m_pendingPositionReplies.append(message());
+        return NoPositionFields;
+    }
+
     if (m_currentLocation.timestamp() > 0) {
         qDebug() << "GetPosition:"
                                         << "timestamp:" << m_currentLocation.timestamp()
@@ -265,83 +311,283 @@ int YandexProvider::GetPosition(int &timestamp, double &latitude, double &longit
         qDebug() << "GetPosition: no valid current location known";
     }
 
-    PositionFields positionFields = NoPositionFields;
-
     timestamp = m_currentLocation.timestamp() / 1000;
-    if (!qIsNaN(m_currentLocation.latitude()))
-        positionFields |= LatitudePresent;
     latitude = m_currentLocation.latitude();
-    if (!qIsNaN(m_currentLocation.longitude()))
-        positionFields |= LongitudePresent;
     longitude = m_currentLocation.longitude();
-    if (!qIsNaN(m_currentLocation.altitude()))
-        positionFields |= AltitudePresent;
     altitude = m_currentLocation.altitude();
     accuracy = m_currentLocation.accuracy();
 
-    return positionFields;
+    return positionFields(m_currentLocation);
+}
+
+uint YandexProvider::AddCircularGeofence(double latitude, double longitude, double radius)
+{
+    if (!calledFromDBus())
+        qFatal("AddCircularGeofence must only be called from DBus");
+
+    // NaN fails every comparison, so the coordinates are checked to be finite first.
+    if (!qIsFinite(latitude) || !qIsFinite(longitude) || !qIsFinite(radius)
+            || qAbs(latitude) > 90 || qAbs(longitude) > 180
+            || radius <= 0 || radius > MaximumGeofenceRadius) {
+        sendErrorReply(QDBusError::InvalidArgs, QStringLiteral("Invalid circular geofence"));
+        return 0;
+    }
+    if (!canAddGeofence()) {
+        return 0;
+    }
+
+    MlsdbCoords center;
+    center.lat = latitude;
+    center.lon = longitude;
+    const uint id = m_geofences.addCircle(message().service(), center, radius);
+    qDebug() << "added circular geofence" << id << "for" << message().service();
+    geofenceAdded();
+    return id;
+}
+
+uint YandexProvider::AddPolygonalGeofence(const QList<double> &vertices)
+{
+    if (!calledFromDBus())
+        qFatal("AddPolygonalGeofence must only be called from DBus");
+
+    // latitude, longitude pairs.
+    QVector<MlsdbCoords> polygon;
+    for (int i = 0; i + 1 < vertices.size(); i += 2) {
+        MlsdbCoords vertex;
+        vertex.lat = vertices.at(i);
+        vertex.lon = vertices.at(i + 1);
+        if (!qIsFinite(vertex.lat) || !qIsFinite(vertex.lon)
+                || qAbs(vertex.lat) > 90 || qAbs(vertex.lon) > 180) {
+            break;
+        }
+        polygon.append(vertex);
+    }
+    if (vertices.size() % 2 != 0 || polygon.size() != vertices.size() / 2
+            || polygon.size() < 3 || polygon.size() > MaximumGeofenceVertices) {
+        sendErrorReply(QDBusError::InvalidArgs, QStringLiteral("Invalid polygonal geofence"));
+        return 0;
+    }
+    if (!canAddGeofence()) {
+        return 0;
+    }
+
+    const uint id = m_geofences.addPolygon(message().service(), polygon);
+    qDebug() << "added polygonal geofence" << id << "with" << polygon.size() << "vertices for" << message().service();
+    geofenceAdded();
+    return id;
+}
+
+void YandexProvider::RemoveGeofence(uint id)
+{
+    if (!calledFromDBus())
+        qFatal("RemoveGeofence must only be called from DBus");
+
+    const QString service = message().service();
+    if (!m_geofences.remove(service, id)) {
+        sendErrorReply(QDBusError::InvalidArgs, QStringLiteral("Unknown geofence"));
+        return;
+    }
+    if (m_geofences.count(service) == 0 && !m_watchedServices.contains(service)) {
+        m_watcher->removeWatchedService(service);
+    }
+    if (!hasPositioningUsers()) {
+        qDebug() << "no watched services, starting idle timer.";
+        m_idleTimer.start(QuitIdleTime, Qt::VeryCoarseTimer, this);
+    }
+
+    stopPositioningIfNeeded();
+}
+
+bool YandexProvider::hasPositioningUsers() const
+{
+    // services with geofences need positioning as much as those holding a reference.
+    return !m_watchedServices.isEmpty() || !m_geofences.isEmpty();
+}
+
+void YandexProvider::geofenceAdded()
+{
+    m_idleTimer.stop();
+    if (m_positioningStarted) {
+        evaluateGeofences();
+    } else {
+        startPositioningIfNeeded(); // evaluates the geofences with the first fix
+    }
+}
+
+bool YandexProvider::canAddGeofence()
+{
+    const QString service = message().service();
+    if (m_geofences.count(service) >= MaximumGeofences) {
+        sendErrorReply(QDBusError::LimitsExceeded, QStringLiteral("Too many geofences"));
+        return false;
+    }
+    // the geofences of the service are removed when it goes away.
+    m_watcher->addWatchedService(service);
+    return true;
+}
+
+void YandexProvider::evaluateGeofences()
+{
+    if (m_currentLocation.timestamp() == 0) {
+        return;
+    }
+
+    // only the services whose geofences were crossed are woken up.
+    MlsdbCoords position;
+    position.lat = m_currentLocation.latitude();
+    position.lon = m_currentLocation.longitude();
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    Q_FOREACH (const GeofenceIndex::Event &event,
+               m_geofences.update(position, m_currentLocation.accuracy().horizontal())) {
+        qDebug() << "geofence" << event.id << (event.transition == GeofenceIndex::Entered ? "entered" : "exited");
+        QDBusMessage targetedSignal = QDBusMessage::createTargetedSignal(event.owner, PositionObjectPath,
+                                                                         GeofenceInterface, QStringLiteral("GeofenceTransition"));
+        targetedSignal << uint(event.id) << int(event.transition);
+        connection.send(targetedSignal);
+    }
+}
+
+void YandexProvider::replyPendingPositionRequests()
+{
+    m_positionReplyTimer.stop();
+    if (m_pendingPositionReplies.isEmpty()) {
+        return;
+    }
+
+    qDebug() << "replying to" << m_pendingPositionReplies.size() << "waiting GetPosition calls, timestamp:"
+             << m_currentLocation.timestamp();
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    Q_FOREACH (const QDBusMessage &request, m_pendingPositionReplies) {
+        QDBusMessage reply = request.createReply();
+        reply << int(positionFields(m_currentLocation)) << int(m_currentLocation.timestamp() / 1000)
+              << m_currentLocation.latitude() << m_currentLocation.longitude()
+              << m_currentLocation.altitude() << QVariant::fromValue(m_currentLocation.accuracy());
+        connection.send(reply);
+    }
+    m_pendingPositionReplies.clear();
 }
 
 void YandexProvider::timerEvent(QTimerEvent *event)
 {
-    //DEBUG
-    calculatePositionAndEmitLocation();
+    // the timers are very coarse: they fire on whole second boundaries, so
+    // that their wakeups coincide with those of the other services.  count
+    // the wakeups, to keep an eye on it.
+    if (++m_timerWakeups % WakeupReportInterval == 0) {
+        reportWakeups();
+    }
 
     if (event->timerId() == m_idleTimer.timerId()) {
         m_idleTimer.stop();
         qDebug() << "have been idle for too long, quitting";
-//        qApp->quit();
+        reportWakeups();
+        qApp->quit();
+    } else if (event->timerId() == m_cellCacheSaveTimer.timerId()) {
+        QMetaObject::invokeMethod(m_engine, "saveCellCache", Qt::QueuedConnection);
+    } else if (event->timerId() == m_positionReplyTimer.timerId()) {
+        replyPendingPositionRequests();
+    } else if (event->timerId() == m_deliveryTimer.timerId()) {
+        m_deliveryTimer.stop();
+        emitLocationChanged();
     } else if (event->timerId() == m_fixLostTimer.timerId()) {
         m_fixLostTimer.stop();
         setStatus(StatusAcquiring);
     } else if (event->timerId() == m_recalculatePositionTimer.timerId()) {
+        m_recalculatePositionTimer.stop();
         const qint64 currTimestamp = QDateTime::currentMSecsSinceEpoch();
-        if (!m_positioningEnabled) {
+        if (!m_positioningEnabled || !m_positioningStarted) {
             qDebug() << "positioning is disabled, preventing MLS calculation";
-        } else if (m_currentLocation.timestamp() == 0
+            return;
+        }
+        if (m_currentLocation.timestamp() == 0
                 || ((currTimestamp - m_currentLocation.timestamp()) > ReuseInterval)
                 || m_signalUpdateCell || m_signalUpdateWlan) {
             qDebug() << "calculating new position information";
-            m_signalUpdateCell = false;
-            m_signalUpdateWlan = false;
             calculatePositionAndEmitLocation();
         } else {
             qDebug() << "re-using old position information";
             setLocation(m_currentLocation);
         }
+        // the next update is due at the clients' interval, unless a change comes first.
+        scheduleRecalculation(currTimestamp + minimumRequestedUpdateInterval());
     } else {
         QObject::timerEvent(event);
     }
 }
 
+void YandexProvider::reportWakeups() const
+{
+    // the online locator's timers run on the same thread, so they count too.
+    const quint32 wakeups = m_timerWakeups + (m_mlsdbOnlineLocator ? m_mlsdbOnlineLocator->timerWakeups() : 0);
+    const qint64 elapsed = m_wakeupClock.elapsed();
+    qDebug() << "timer wakeups:" << wakeups << "in" << elapsed / 1000 << "s,"
+             << (elapsed > 0 ? wakeups * 3600000.0 / elapsed : 0.0) << "per hour";
+}
+
+void YandexProvider::requestRecalculation()
+{
+    // change events are coalesced: the calculation runs once the minimum
+    // interval since the previous one has passed, for all of them at once.
+    scheduleRecalculation(m_lastCalculationTime + MinimumInterval);
+}
+
+void YandexProvider::scheduleRecalculation(qint64 due)
+{
+    if (!m_positioningStarted) {
+        return;
+    }
+    if (m_recalculatePositionTimer.isActive() && m_recalculationDue <= due) {
+        return; // an earlier calculation is scheduled already
+    }
+    const qint64 delay = due - QDateTime::currentMSecsSinceEpoch();
+    m_recalculationDue = due;
+    m_recalculatePositionTimer.start(int(qBound<qint64>(0, delay, INT_MAX)), Qt::VeryCoarseTimer, this);
+}
+
 void YandexProvider::calculatePositionAndEmitLocation()
 {
+    // both sources run concurrently: the local estimate is published as soon
+    // as it has been calculated, and the online answer replaces it when it
+    // arrives, if it is more accurate.
+    m_lastCalculationTime = QDateTime::currentMSecsSinceEpoch();
+    m_signalUpdateCell = false;
+    m_signalUpdateWlan = false;
+
     const QList<CellPositioningData> cellIds = seenCellIds();
+    updateLocationFromCells(cellIds);
     if (m_onlinePositioningEnabled) {
-        if (!m_mlsdbOnlineLocator) {
-            m_mlsdbOnlineLocator = new YandexOnlineLocator(this);
-            m_mlsdbOnlineLocator->setWlanDataAllowed(m_wlanDataAllowed);
-            connect(m_mlsdbOnlineLocator, &YandexOnlineLocator::wlanChanged,
-                    this, &YandexProvider::onlineWlanChanged);
-            connect(m_mlsdbOnlineLocator, &YandexOnlineLocator::locationFound,
-                    this, &YandexProvider::onlineLocationFound);
-            connect(m_mlsdbOnlineLocator, &YandexOnlineLocator::error,
-                    this, &YandexProvider::onlineLocationError);
-        }
+        onlineLocator()->findLocation(cellIds);
+    }
+}
 
-        if (m_mlsdbOnlineLocator->findLocation()) {
-            //m_previousQuery = query;
-            return;
-        }
+YandexOnlineLocator *YandexProvider::onlineLocator()
+{
+    if (!m_mlsdbOnlineLocator) {
+        m_mlsdbOnlineLocator = new YandexOnlineLocator(this);
+        m_mlsdbOnlineLocator->setWlanDataAllowed(m_wlanDataAllowed);
+        connect(m_mlsdbOnlineLocator, &YandexOnlineLocator::wlanChanged,
+                this, &YandexProvider::onlineWlanChanged);
+        connect(m_mlsdbOnlineLocator, &YandexOnlineLocator::locationFound,
+                this, &YandexProvider::onlineLocationFound);
+        connect(m_mlsdbOnlineLocator, &YandexOnlineLocator::error,
+                this, &YandexProvider::onlineLocationError);
     }
+    return m_mlsdbOnlineLocator;
+}
 
-    // fall back to using offline position
-    updateLocationFromCells(cellIds);
+void YandexProvider::prewarmOnlineConnection()
+{
+    // positioning started or the radio environment changed, a request is likely
+    // to follow: get the connection to the service ready.
+    if (m_positioningStarted && m_onlinePositioningEnabled) {
+        onlineLocator()->prewarmConnection();
+    }
 }
 
 void YandexProvider::onlineWlanChanged()
 {
     m_signalUpdateWlan = true;
+    prewarmOnlineConnection();
+    requestRecalculation();
 }
 
 void YandexProvider::onlineLocationFound(double latitude, double longitude, double accuracy)
@@ -357,16 +603,24 @@ void YandexProvider::onlineLocationFound(double latitude, double longitude, doub
     positionAccuracy.setHorizontal(accuracy);
     deviceLocation.setAccuracy(positionAccuracy);
 
+    // the offline estimate published meanwhile may still be the better one.
+    if (accuracy >= 0
+            && m_currentLocation.timestamp() != 0
+            && (deviceLocation.timestamp() - m_currentLocation.timestamp()) < FallbackInterval
+            && m_currentLocation.accuracy().horizontal() < accuracy) {
+        qDebug() << "keeping offline position due to better accuracy:"
+                 << m_currentLocation.accuracy().horizontal() << "over:" << accuracy;
+        return;
+    }
+
     setLocation(deviceLocation);
 }
 
 void YandexProvider::onlineLocationError(const QString &errorString)
 {
+    // the offline estimate has been calculated alongside the request already.
     qDebug() << "Cannot fetch position from online source:" << errorString
-                                    << ", falling back to offline source";
-
-    // fall back to using offline position
-    updateLocationFromCells(seenCellIds());
+                                    << ", keeping offline position";
 }
 
 QList<YandexProvider::CellPositioningData> YandexProvider::seenCellIds() const
@@ -409,6 +663,7 @@ QList<YandexProvider::CellPositioningData> YandexProvider::seenCellIds() const
             qDebug() << "have neighbour cell:" << cell.uniqueCellId.toString()
                                             << "with strength:" << c->signalStrength();
             cell.signalStrength = c->signalStrength();
+            cell.registered = c->registered();
             if (cell.signalStrength > maxNeighborSignalStrength) {
                 // used for the cells we're connected to.
                 // if no signal strength data is available from ofono,
@@ -425,71 +680,35 @@ QList<YandexProvider::CellPositioningData> YandexProvider::seenCellIds() const
 
 void YandexProvider::updateLocationFromCells(const QList<CellPositioningData> &cells)
 {
-    // determine which cells we have an accurate location for, from MLSDB data.
-    double totalSignalStrength = 0.0;
-    QMap<MlsdbUniqueCellId, MlsdbCoords> cellLocations;
-    Q_FOREACH (const CellPositioningData &cell, cells) {
-        MlsdbCoords cellCoords;
-        if (!m_uniqueCellIdToLocation.contains(cell.uniqueCellId)) {
-            if (m_knownCellIdsWithUnknownLocations.contains(cell.uniqueCellId)) {
-                // we know that we don't know the location of this cellId.  Skip it.
-                continue;
-            } else {
-                // this is a new cell Id that we haven't encountered yet.  Probe it.
-                if (!searchForCellIdLocation(cell.uniqueCellId, &cellCoords)) {
-                    // we now know that we don't know the location of this cellId.
-                    m_knownCellIdsWithUnknownLocations.insert(cell.uniqueCellId);
-                    continue;
-                }
-                // cache the location of the cell id for future reference.
-                m_uniqueCellIdToLocation.insert(cell.uniqueCellId, cellCoords);
-            }
-        } else {
-            cellCoords = m_uniqueCellIdToLocation.value(cell.uniqueCellId);
-        }
-        // we have a known location for this cell.  Update our locations list.
-        cellLocations.insert(cell.uniqueCellId, cellCoords);
-        totalSignalStrength += (1.0 * cell.signalStrength);
+    // only keep one calculation in flight, snapshots seen meanwhile are
+    // coalesced into the latest one, which is posted once the result arrives.
+    if (m_offlineCalculationPending) {
+        m_queuedCells = cells;
+        m_offlineCalculationQueued = true;
+        return;
     }
 
-    if (cellLocations.size() == 0) {
-        qDebug() << "no cell id data to calculate position from";
-        return;
-    } else if (cellLocations.size() == 1) {
-        qDebug() << "only one cell id datum to calculate position from, position will be extremely inaccurate";
-    } else if (cellLocations.size() == 2) {
-        qDebug() << "only two cell id data to calculate position from, position will be highly inaccurate";
-    } else {
-        qDebug() << "calculating position from" << cellLocations.size() << "cell id data";
-    }
-
-    // now use the current cell and neighboringcell information to triangulate our position.
-    double deviceLatitude = 0.0;
-    double deviceLongitude = 0.0;
-    Q_FOREACH (const CellPositioningData &cell, cells) {
-        if (cellLocations.contains(cell.uniqueCellId)) {
-            const MlsdbCoords &cellCoords(cellLocations.value(cell.uniqueCellId));
-            double weight = (((double)cell.signalStrength) / totalSignalStrength);
-            deviceLatitude += (weight * cellCoords.lat);
-            deviceLongitude += (weight * cellCoords.lon);
-            qDebug() << "have cell:" << cell.uniqueCellId.toString()
-                                            << "with position:" << cellCoords.lat << "," << cellCoords.lon
-                                            << "with strength:" << ((double)cell.signalStrength / totalSignalStrength);
-        } else {
-            qDebug() << "do not know position of cell with id:" << cell.uniqueCellId.toString();
-        }
+    m_offlineCalculationPending = true;
+    QMetaObject::invokeMethod(m_engine, "calculateLocation", Qt::QueuedConnection,
+                              Q_ARG(QList<MlsdbCellPositioningData>, cells));
+}
+
+void YandexProvider::offlineLocationCalculated(const Location &deviceLocation)
+{
+    m_offlineCalculationPending = false;
+    if (m_offlineCalculationQueued) {
+        m_offlineCalculationQueued = false;
+        const QList<CellPositioningData> cells(m_queuedCells);
+        m_queuedCells.clear();
+        updateLocationFromCells(cells);
     }
 
-    Location deviceLocation;
-    if (cellLocations.size()) {
-        // estimate accuracy based on how many cells we have.
-        Accuracy positionAccuracy;
-        positionAccuracy.setHorizontal(qMax(MinimumCalculatedAccuracy,
-                                            10000 - (1000 * cellLocations.size())));
-        deviceLocation.setTimestamp(QDateTime::currentMSecsSinceEpoch());
-        deviceLocation.setLatitude(deviceLatitude);
-        deviceLocation.setLongitude(deviceLongitude);
-        deviceLocation.setAccuracy(positionAccuracy);
+    if (!m_positioningStarted) {
+        qDebug() << "positioning stopped, ignoring calculated position";
+        return;
+    }
+    if (deviceLocation.timestamp() == 0) {
+        return;
     }
 
     // and set this as our location if it is at least as accurate as our previous data,
@@ -519,24 +738,37 @@ void YandexProvider::setLocation(const Location &location)
 
     if (location.timestamp() != 0) {
         setStatus(StatusAvailable);
-        m_fixLostTimer.start(FixTimeout, this);
+        m_fixLostTimer.start(FixTimeout, Qt::VeryCoarseTimer, this);
         m_lastLocation = m_currentLocation;
+        m_warmStartLocation = Location(); // superseded
+        if (location.timestamp() != m_lastSavedTimestamp) {
+            m_lastSavedTimestamp = location.timestamp();
+            QMetaObject::invokeMethod(m_engine, "saveLastLocation", Qt::QueuedConnection,
+                                      Q_ARG(Location, location),
+                                      Q_ARG(QList<MlsdbCellPositioningData>, seenCellIds()));
+        }
     } else {
         qDebug() << "location invalid, lost positioning fix";
         m_lastLocation = Location(); // lost fix, reset last location also.
     }
 
     m_currentLocation = location;
+    m_positionFeed.publish(m_currentLocation, positionFields(m_currentLocation));
+    if (m_currentLocation.timestamp() != 0) {
+        replyPendingPositionRequests();
+        evaluateGeofences();
+    }
     emitLocationChanged();
 }
 
 void YandexProvider::serviceUnregistered(const QString &service)
 {
+    m_geofences.removeOwner(service);
     m_watchedServices.remove(service);
     m_watcher->removeWatchedService(service);
-    if (m_watchedServices.isEmpty()) {
+    if (!hasPositioningUsers()) {
         qDebug() << "no watched services, starting idle timer.";
-        m_idleTimer.start(QuitIdleTime, this);
+        m_idleTimer.start(QuitIdleTime, Qt::VeryCoarseTimer, this);
     }
 
     stopPositioningIfNeeded();
@@ -625,23 +857,159 @@ void YandexProvider::updatePositioningEnabled()
 
 void YandexProvider::cellularNetworkRegistrationChanged()
 {
-    m_signalUpdateCell = true;
+    warmStartIfNeeded();
+
+    // signal strength jitter alone doesn't warrant a recalculation.
+    QHash<QString, int> strengths;
+    Q_FOREACH (const CellPositioningData &cell, seenCellIds()) {
+        strengths.insert(cell.uniqueCellId.toString(), cell.signalStrength);
+    }
+    const bool changed = m_cellEnvironment.update(strengths);
+    qDebug() << "cell environment change score:" << m_cellEnvironment.score()
+             << "threshold:" << m_cellEnvironment.threshold();
+    if (changed) {
+        m_signalUpdateCell = true;
+        prewarmOnlineConnection();
+        requestRecalculation();
+    }
+}
+
+void YandexProvider::warmStartIfNeeded()
+{
+    // only served to clients, startPositioningIfNeeded() calls this again.
+    if (m_warmStartLocation.timestamp() == 0 || m_currentLocation.timestamp() != 0
+            || !m_positioningStarted || !m_cellDataAllowed || !m_cellWatcher) {
+        return;
+    }
+
+    const qint64 age = QDateTime::currentMSecsSinceEpoch() - m_warmStartLocation.timestamp();
+    if (age < 0 || age > WarmStartMaximumAge) {
+        qDebug() << "persisted location is too old to be served:" << age << "ms";
+        m_warmStartLocation = Location();
+        return;
+    }
+
+    // the serving cell may not be known yet right after activation, wait for it.
+    bool haveServingCell = false;
+    bool servingCellMatches = false;
+    Q_FOREACH (const CellPositioningData &cell, seenCellIds()) {
+        if (cell.registered) {
+            haveServingCell = true;
+            servingCellMatches |= m_warmStartCellIds.contains(cell.uniqueCellId);
+        }
+    }
+    if (!haveServingCell) {
+        return;
+    }
+
+    const Location location(m_warmStartLocation);
+    m_warmStartLocation = Location();
+    if (!servingCellMatches) {
+        qDebug() << "serving cell has changed, not serving persisted location";
+        return;
+    }
+
+    Accuracy positionAccuracy;
+    const double storedAccuracy = location.accuracy().horizontal();
+    positionAccuracy.setHorizontal(qMax(storedAccuracy,
+                                        qMin(storedAccuracy + WarmStartDriftSpeed * age / 1000.0,
+                                             WarmStartMaximumAccuracy)));
+    Location warmStartLocation;
+    warmStartLocation.setTimestamp(location.timestamp());
+    warmStartLocation.setLatitude(location.latitude());
+    warmStartLocation.setLongitude(location.longitude());
+    warmStartLocation.setAccuracy(positionAccuracy);
+    qDebug() << "serving persisted location from" << age << "ms ago in the same serving cell";
+    setLocation(warmStartLocation);
 }
 
 void YandexProvider::emitLocationChanged()
 {
-    PositionFields positionFields = NoPositionFields;
+    // every client gets the position at its own update interval, and only
+    // if it differs noticeably from the position it was given last.
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QStringList dueServices;
+    qint64 nextDelivery = 0;
+    for (QMap<QString, ServiceData>::iterator it = m_watchedServices.begin(); it != m_watchedServices.end(); ++it) {
+        const ServiceData &data(it.value());
+        if (!positionChanged(data.deliveredLocation, m_currentLocation)) {
+            continue;
+        }
+        const qint64 deadline = data.lastDelivery + data.updateInterval;
+        if (m_currentLocation.timestamp() == 0 || deadline <= now) {
+            dueServices.append(it.key());
+        } else if (nextDelivery == 0 || deadline < nextDelivery) {
+            nextDelivery = deadline;
+        }
+    }
 
-    if (!qIsNaN(m_currentLocation.latitude()))
-        positionFields |= LatitudePresent;
-    if (!qIsNaN(m_currentLocation.longitude()))
-        positionFields |= LongitudePresent;
-    if (!qIsNaN(m_currentLocation.altitude()))
-        positionFields |= AltitudePresent;
+    m_deliveryTimer.stop();
+    if (nextDelivery != 0) {
+        m_deliveryTimer.start(int(qMin<qint64>(nextDelivery - now, INT_MAX)), Qt::VeryCoarseTimer, this);
+    }
+    if (dueServices.isEmpty()) {
+        return;
+    }
+
+    const PositionFields fields = positionFields(m_currentLocation);
+
+    Q_FOREACH (const QString &service, dueServices) {
+        ServiceData &data(m_watchedServices[service]);
+        data.deliveredLocation = m_currentLocation;
+        data.lastDelivery = now;
+    }
+
+    if (dueServices.size() == m_watchedServices.size()) {
+        emit PositionChanged(fields, m_currentLocation.timestamp() / 1000,
+                             m_currentLocation.latitude(), m_currentLocation.longitude(),
+                             m_currentLocation.altitude(), m_currentLocation.accuracy());
+        return;
+    }
+
+    // only some of the clients are due, don't wake up the others.
+    QDBusConnection connection = QDBusConnection::sessionBus();
+    Q_FOREACH (const QString &service, dueServices) {
+        QDBusMessage targetedSignal = QDBusMessage::createTargetedSignal(service, PositionObjectPath,
+                                                                         PositionInterface, QStringLiteral("PositionChanged"));
+        targetedSignal << int(fields) << int(m_currentLocation.timestamp() / 1000)
+               << m_currentLocation.latitude() << m_currentLocation.longitude()
+               << m_currentLocation.altitude() << QVariant::fromValue(m_currentLocation.accuracy());
+        connection.send(targetedSignal);
+    }
+}
+
+YandexProvider::PositionFields YandexProvider::positionFields(const Location &location)
+{
+    PositionFields fields = NoPositionFields;
+
+    if (!qIsNaN(location.latitude()))
+        fields |= LatitudePresent;
+    if (!qIsNaN(location.longitude()))
+        fields |= LongitudePresent;
+    if (!qIsNaN(location.altitude()))
+        fields |= AltitudePresent;
+
+    return fields;
+}
+
+bool YandexProvider::positionChanged(const Location &previous, const Location &current)
+{
+    if (previous.timestamp() == 0 || current.timestamp() == 0) {
+        return previous.timestamp() != current.timestamp();
+    }
+
+    const double previousAccuracy = previous.accuracy().horizontal();
+    const double currentAccuracy = current.accuracy().horizontal();
+    if (qIsNaN(previousAccuracy) != qIsNaN(currentAccuracy)
+            || qAbs(currentAccuracy - previousAccuracy) > previousAccuracy * DeliveryAccuracyChange) {
+        return true;
+    }
 
-    emit PositionChanged(positionFields, m_currentLocation.timestamp() / 1000,
-                         m_currentLocation.latitude(), m_currentLocation.longitude(),
-                         m_currentLocation.altitude(), m_currentLocation.accuracy());
+    // equirectangular approximation, plenty for distances of a few cells.
+    const double meanLatitude = qDegreesToRadians((previous.latitude() + current.latitude()) / 2);
+    const double x = qDegreesToRadians(current.longitude() - previous.longitude()) * qCos(meanLatitude);
+    const double y = qDegreesToRadians(current.latitude() - previous.latitude());
+    return qSqrt(x * x + y * y) * EarthRadius >= DeliveryMinimumMovement;
 }
 
 void YandexProvider::startPositioningIfNeeded()
@@ -651,7 +1019,7 @@ void YandexProvider::startPositioningIfNeeded()
         return;
 
     // Positioning is unused.
-    if (m_watchedServices.isEmpty())
+    if (!hasPositioningUsers())
         return;
 
     // Positioning disabled externally
@@ -662,9 +1030,11 @@ void YandexProvider::startPositioningIfNeeded()
 
     qDebug() << "Starting positioning";
     m_positioningStarted = true;
+    m_cellCacheSaveTimer.start(CellCacheSaveInterval, Qt::VeryCoarseTimer, this);
+    warmStartIfNeeded();
+    prewarmOnlineConnection();
     calculatePositionAndEmitLocation();
-    quint32 updateInterval = minimumRequestedUpdateInterval();
-    m_recalculatePositionTimer.start(updateInterval, this);
+    scheduleRecalculation(m_lastCalculationTime + minimumRequestedUpdateInterval());
 }
 
 void YandexProvider::stopPositioningIfNeeded()
@@ -674,14 +1044,19 @@ void YandexProvider::stopPositioningIfNeeded()
         return;
 
     // Positioning enabled externally and positioning is still being used.
-    if (m_positioningEnabled && !m_watchedServices.isEmpty())
+    if (m_positioningEnabled && hasPositioningUsers())
         return;
 
     qDebug() << "Stopping positioning";
     m_positioningStarted = false;
     setStatus(StatusUnavailable);
     m_fixLostTimer.stop();
+    m_deliveryTimer.stop();
     m_recalculatePositionTimer.stop();
+    replyPendingPositionRequests();
+    m_cellCacheSaveTimer.stop();
+    QMetaObject::invokeMethod(m_engine, "saveCellCache", Qt::QueuedConnection);
+    reportWakeups();
 }
 
 void YandexProvider::setStatus(YandexProvider::Status status)
@@ -22,11 +22,18 @@
 #include <QtCore/QSet>
 #include <QtCore/QMap>
 #include <QtCore/QDateTime>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QThread>
 #include <QtCore/QVariantMap>
 #include <QtDBus/QDBusContext>
+#include <QtDBus/QDBusMessage>
 
 #include "locationtypes.h"
 #include "mlsdbserialisation.h"
+#include "mlsdbengine.h"
+#include "radioenvironment.h"
+#include "yandexpositionfeedwriter.h"
+#include "geofenceindex.h"
 
 /*
 // TODO: use RIL to perform RIL_REQUEST_GET_NEIGHBORING_CELL_IDS
@@ -56,7 +63,8 @@ class YandexOnlineLocator;
  * and signal strength information available from the RIL.
  *
  * The geographic location of the given cell id is looked up
- * from a Mozilla Location Service database.
+ * from a Mozilla Location Service database, by an MlsdbEngine
+ * running on a worker thread.
  */
 
 class YandexProvider : public QObject, public QDBusContext
@@ -64,10 +72,7 @@ class YandexProvider : public QObject, public QDBusContext
     Q_OBJECT
 
 public:
-    struct CellPositioningData {
-        MlsdbUniqueCellId uniqueCellId;
-        quint32 signalStrength;
-    };
+    typedef MlsdbCellPositioningData CellPositioningData;
 
     explicit YandexProvider(QObject *parent = 0);
     ~YandexProvider();
@@ -105,6 +110,11 @@ public:
     // org.freedesktop.Geoclue.Position
     int GetPosition(int &timestamp, double &latitude, double &longitude, double &altitude, Accuracy &accuracy);
 
+    // org.freedesktop.Geoclue.Providers.Yandex.Geofence
+    uint AddCircularGeofence(double latitude, double longitude, double radius);
+    uint AddPolygonalGeofence(const QList<double> &vertices);
+    void RemoveGeofence(uint id);
+
 signals:
     // org.freedesktop.Geoclue
     void StatusChanged(int status);
@@ -112,6 +122,9 @@ signals:
     // org.freedesktop.Geoclue.Position
     void PositionChanged(int fields, int timestamp, double latitude, double longitude, double altitude, const Accuracy &accuracy);
 
+    // org.freedesktop.Geoclue.Providers.Yandex.Geofence, sent to the owner of the geofence only
+    void GeofenceTransition(uint id, int transition);
+
 private Q_SLOTS:
     void setLocation(const Location &location);
     void serviceUnregistered(const QString &service);
@@ -120,12 +133,21 @@ private Q_SLOTS:
     void onlineLocationFound(double latitude, double longitude, double accuracy);
     void onlineLocationError(const QString &errorString);
     void onlineWlanChanged();
+    void offlineLocationCalculated(const Location &location);
 
 protected:
     void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE; // QObject
 
 private:
     void emitLocationChanged();
+    void replyPendingPositionRequests();
+    bool canAddGeofence();
+    void geofenceAdded();
+    bool hasPositioningUsers() const;
+    void evaluateGeofences();
+    static PositionFields positionFields(const Location &location);
+    static bool positionChanged(const Location &previous, const Location &current);
+    void warmStartIfNeeded();
     void startPositioningIfNeeded();
     void stopPositioningIfNeeded();
     void setStatus(Status status);
@@ -134,10 +156,14 @@ private:
                     bool *cellDataAllowed, bool *wlanDataAllowed);
     quint32 minimumRequestedUpdateInterval() const;
     void calculatePositionAndEmitLocation();
+    void requestRecalculation();
+    void reportWakeups() const;
+    void scheduleRecalculation(qint64 due);
+    YandexOnlineLocator *onlineLocator();
+    void prewarmOnlineConnection();
 
     QList<CellPositioningData> seenCellIds() const;
     void updateLocationFromCells(const QList<CellPositioningData> &cells);
-    bool searchForCellIdLocation(const MlsdbUniqueCellId &uniqueCellId, MlsdbCoords *coords);
 
     QFileSystemWatcher m_locationSettingsWatcher;
     bool m_positioningEnabled;
@@ -146,32 +172,51 @@ private:
     Status m_status;
     Location m_currentLocation;
     Location m_lastLocation;
+    YandexPositionFeedWriter m_positionFeed;
+    GeofenceIndex m_geofences;
+    Location m_warmStartLocation;               // persisted fix, until it has been served or discarded
+    QList<MlsdbUniqueCellId> m_warmStartCellIds; // serving cells at the time of the persisted fix
+    qint64 m_lastSavedTimestamp;
+    qint64 m_lastCalculationTime;
+    qint64 m_recalculationDue;
+    quint32 m_timerWakeups;
+    QElapsedTimer m_wakeupClock;
 
     YandexOnlineLocator *m_mlsdbOnlineLocator;
     bool m_onlinePositioningEnabled;
     bool m_onlineDataAllowed;
     bool m_wlanDataAllowed;
-    QPair<QDateTime, QVariantMap> m_previousQuery;
 
     QOfonoExtCellWatcher *m_cellWatcher;
-    QMap<MlsdbUniqueCellId, MlsdbCoords> m_uniqueCellIdToLocation; // cache
-    QSet<MlsdbUniqueCellId> m_knownCellIdsWithUnknownLocations;
+    RadioEnvironment m_cellEnvironment;
+    QThread m_engineThread;
+    MlsdbEngine *m_engine;          // lives on m_engineThread
+    bool m_offlineCalculationPending;
+    bool m_offlineCalculationQueued;
+    QList<CellPositioningData> m_queuedCells; // latest snapshot seen while a calculation was pending
 
     QDBusServiceWatcher *m_watcher;
     struct ServiceData {
         ServiceData()
-        :   referenceCount(0), updateInterval(0)
+        :   referenceCount(0), updateInterval(0), lastDelivery(0), waitForFix(false)
         {
         }
 
         int referenceCount;
         quint32 updateInterval;
+        Location deliveredLocation; // the position last sent to the service
+        qint64 lastDelivery;
+        bool waitForFix;            // GetPosition replies are delayed until there is a fix
     };
     QMap<QString, ServiceData> m_watchedServices;
+    QList<QDBusMessage> m_pendingPositionReplies; // GetPosition calls waiting for the first fix
 
     QBasicTimer m_idleTimer;    // qApp->quit() if positioning is off for long enough.
     QBasicTimer m_fixLostTimer; // after fix timeout, status set to Acquiring.  timer is reset when a position is calculated.
-    QBasicTimer m_recalculatePositionTimer;
+    QBasicTimer m_recalculatePositionTimer; // single shot, scheduled by change events and the clients' update interval
+    QBasicTimer m_positionReplyTimer; // replies to the waiting GetPosition calls, if no fix has been calculated in time.
+    QBasicTimer m_deliveryTimer;      // delivers the position to services whose update interval has passed.
+    QBasicTimer m_cellCacheSaveTimer; // periodically persists the cell location cache while positioning.
 
     bool m_signalUpdateCell;
     bool m_signalUpdateWlan;
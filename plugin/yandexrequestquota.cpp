@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "yandexrequestquota.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QtDebug>
+
+namespace {
+    const QString QuotaTokensKey(QStringLiteral("/mlsprovider/quota_tokens"));
+    const QString QuotaUpdatedKey(QStringLiteral("/mlsprovider/quota_updated"));
+    const double MsecsPerDay = 24.0 * 60 * 60 * 1000;
+}
+
+YandexRequestQuota::YandexRequestQuota(quint32 dailyQuota, quint32 burst)
+    : m_dailyQuota(dailyQuota)
+    , m_capacity(qMax(1u, qMin(dailyQuota, burst)))
+    , m_tokens(m_capacity)
+    , m_updated(QDateTime::currentMSecsSinceEpoch())
+    , m_tokensItem(QuotaTokensKey)
+    , m_updatedItem(QuotaUpdatedKey)
+{
+    bool tokensOk = false, updatedOk = false;
+    const double tokens = m_tokensItem.value().toDouble(&tokensOk);
+    const qint64 updated = m_updatedItem.value().toLongLong(&updatedOk);
+    if (tokensOk && updatedOk && updated > 0) {
+        m_tokens = qBound(0.0, tokens, m_capacity);
+        m_updated = updated;
+    }
+}
+
+void YandexRequestQuota::refill()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now > m_updated) {
+        m_tokens = qMin(m_capacity, m_tokens + (now - m_updated) * m_dailyQuota / MsecsPerDay);
+    }
+    // also resynchronises if the clock was set back.
+    m_updated = now;
+}
+
+bool YandexRequestQuota::available()
+{
+    if (isUnlimited()) {
+        return true;
+    }
+    refill();
+    return m_tokens >= 1.0;
+}
+
+bool YandexRequestQuota::acquire()
+{
+    if (isUnlimited()) {
+        return true;
+    }
+    refill();
+    if (m_tokens < 1.0) {
+        qDebug() << "daily online request quota of" << m_dailyQuota << "exhausted";
+        return false;
+    }
+    m_tokens -= 1.0;
+    m_tokensItem.set(m_tokens);
+    m_updatedItem.set(m_updated);
+    qDebug() << "online request quota has" << m_tokens << "requests left";
+    return true;
+}
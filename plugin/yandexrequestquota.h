@@ -0,0 +1,47 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef YANDEXREQUESTQUOTA_H
+#define YANDEXREQUESTQUOTA_H
+
+#include <MGConfItem>
+
+/*
+ * The YandexRequestQuota class is a token bucket limiting the online
+ * requests made with the API key to a daily quota.  The bucket refills
+ * continuously at quota tokens per day, and holds at most a small burst
+ * of tokens, so that the quota is spread over the day.
+ *
+ * The bucket state is persisted, so that restarting the provider
+ * doesn't reset the budget.
+ */
+
+class YandexRequestQuota
+{
+public:
+    YandexRequestQuota(quint32 dailyQuota, quint32 burst);
+
+    bool isUnlimited() const { return m_dailyQuota == 0; }
+    bool available();   // whether a request may be made now
+    bool acquire();     // consumes a token, if one is available
+
+private:
+    void refill();
+
+    quint32 m_dailyQuota;
+    double m_capacity;
+    double m_tokens;
+    qint64 m_updated;
+    MGConfItem m_tokensItem;
+    MGConfItem m_updatedItem;
+};
+
+#endif // YANDEXREQUESTQUOTA_H
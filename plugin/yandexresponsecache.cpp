@@ -0,0 +1,261 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "yandexresponsecache.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtDebug>
+
+namespace {
+    const quint32 ResponseCacheMagic = 0x79727363; // "yrsc"
+    const qint32 ResponseCacheVersion = 1;
+}
+
+YandexResponseCache::YandexResponseCache(const QString &fileName, int maximumSize, qint64 ttl,
+                                         double similarityThreshold)
+    : m_fileName(fileName)
+    , m_maximumSize(qMax(1, maximumSize))
+    , m_ttl(ttl)
+    , m_similarityThreshold(similarityThreshold)
+    , m_nextId(0)
+    , m_loaded(false)
+    , m_dirty(false)
+{
+}
+
+YandexResponseCache::~YandexResponseCache()
+{
+}
+
+QStringList YandexResponseCache::normalisedBssids(const QStringList &bssids)
+{
+    QStringList normalised;
+    Q_FOREACH (const QString &bssid, bssids) {
+        const QString lower = bssid.trimmed().toLower();
+        if (!lower.isEmpty() && !normalised.contains(lower)) {
+            normalised.append(lower);
+        }
+    }
+    normalised.sort();
+    return normalised;
+}
+
+QString YandexResponseCache::fingerprint(const QStringList &bssids, const QStringList &cellKeys)
+{
+    return bssids.join(QLatin1Char(',')) + QLatin1Char('|') + cellKeys.join(QLatin1Char(','));
+}
+
+void YandexResponseCache::addEntry(quint32 id, const Entry &entry)
+{
+    m_entries.insert(id, entry);
+    m_fingerprints.insert(fingerprint(entry.bssids, entry.cellKeys), id);
+    Q_FOREACH (const QString &bssid, entry.bssids) {
+        m_bssidIndex[bssid].insert(id);
+    }
+}
+
+void YandexResponseCache::removeEntry(quint32 id)
+{
+    QHash<quint32, Entry>::iterator it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return;
+    }
+    m_fingerprints.remove(fingerprint(it->bssids, it->cellKeys));
+    Q_FOREACH (const QString &bssid, it->bssids) {
+        QHash<QString, QSet<quint32> >::iterator index = m_bssidIndex.find(bssid);
+        if (index != m_bssidIndex.end()) {
+            index->remove(id);
+            if (index->isEmpty()) {
+                m_bssidIndex.erase(index);
+            }
+        }
+    }
+    m_entries.erase(it);
+    m_dirty = true;
+}
+
+void YandexResponseCache::evictLeastRecentlyUsed()
+{
+    quint32 oldestId = 0;
+    qint64 oldestUse = 0;
+    bool found = false;
+    QHash<quint32, Entry>::const_iterator it = m_entries.constBegin();
+    for (; it != m_entries.constEnd(); ++it) {
+        if (!found || it->lastUsed < oldestUse) {
+            oldestId = it.key();
+            oldestUse = it->lastUsed;
+            found = true;
+        }
+    }
+    if (found) {
+        removeEntry(oldestId);
+    }
+}
+
+bool YandexResponseCache::lookup(const QStringList &bssids, const QStringList &cellKeys, Position *position)
+{
+    loadIfNeeded();
+
+    const QStringList sortedBssids = normalisedBssids(bssids);
+    QStringList sortedCellKeys(cellKeys);
+    sortedCellKeys.sort();
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    quint32 bestId = 0;
+    double bestSimilarity = -1.0;
+    QHash<QString, quint32>::const_iterator exact = m_fingerprints.constFind(fingerprint(sortedBssids, sortedCellKeys));
+    if (exact != m_fingerprints.constEnd()) {
+        bestId = exact.value();
+        bestSimilarity = 1.0;
+    } else if (!sortedBssids.isEmpty()) {
+        // only entries sharing at least one access point can be similar.
+        QSet<quint32> candidates;
+        Q_FOREACH (const QString &bssid, sortedBssids) {
+            candidates.unite(m_bssidIndex.value(bssid));
+        }
+        const QSet<QString> queryBssids = sortedBssids.toSet();
+        Q_FOREACH (quint32 id, candidates) {
+            const Entry &entry(m_entries[id]);
+            int shared = 0;
+            Q_FOREACH (const QString &bssid, entry.bssids) {
+                if (queryBssids.contains(bssid)) {
+                    ++shared;
+                }
+            }
+            const double similarity = double(shared) / (queryBssids.size() + entry.bssids.size() - shared);
+            if (similarity > bestSimilarity) {
+                bestSimilarity = similarity;
+                bestId = id;
+            }
+        }
+    }
+
+    if (bestSimilarity < m_similarityThreshold) {
+        return false;
+    }
+
+    QHash<quint32, Entry>::iterator it = m_entries.find(bestId);
+    if (now - it->created > m_ttl) {
+        qDebug() << "online response cache entry expired";
+        removeEntry(bestId);
+        return false;
+    }
+
+    qDebug() << "online response cache hit with similarity" << bestSimilarity;
+    it->lastUsed = now;
+    m_dirty = true;
+    *position = it->position;
+    return true;
+}
+
+void YandexResponseCache::insert(const QStringList &bssids, const QStringList &cellKeys, const Position &position)
+{
+    loadIfNeeded();
+
+    Entry entry;
+    entry.bssids = normalisedBssids(bssids);
+    entry.cellKeys = cellKeys;
+    entry.cellKeys.sort();
+    if (entry.bssids.isEmpty() && entry.cellKeys.isEmpty()) {
+        return;
+    }
+    entry.position = position;
+    entry.created = QDateTime::currentMSecsSinceEpoch();
+    entry.lastUsed = entry.created;
+
+    QHash<QString, quint32>::const_iterator existing = m_fingerprints.constFind(fingerprint(entry.bssids, entry.cellKeys));
+    if (existing != m_fingerprints.constEnd()) {
+        removeEntry(existing.value());
+    }
+    while (m_entries.size() >= m_maximumSize) {
+        evictLeastRecentlyUsed();
+    }
+    addEntry(m_nextId++, entry);
+    m_dirty = true;
+}
+
+void YandexResponseCache::loadIfNeeded()
+{
+    if (m_loaded) {
+        return;
+    }
+    m_loaded = true;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "no online response cache at" << m_fileName;
+        return;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != ResponseCacheMagic || version != ResponseCacheVersion) {
+        qDebug() << "online response cache" << m_fileName << "format unknown:" << magic << version;
+        return;
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Entry entry;
+        in >> entry.bssids >> entry.cellKeys
+           >> entry.position.latitude >> entry.position.longitude >> entry.position.accuracy
+           >> entry.created >> entry.lastUsed;
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+        if (now - entry.created > m_ttl || m_entries.size() >= m_maximumSize) {
+            continue;
+        }
+        addEntry(m_nextId++, entry);
+    }
+
+    m_dirty = false;
+    qDebug() << "loaded" << m_entries.size() << "online responses from cache" << m_fileName;
+}
+
+bool YandexResponseCache::save()
+{
+    if (!m_dirty) {
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "unable to write online response cache" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << ResponseCacheMagic << ResponseCacheVersion << quint32(m_entries.size());
+    Q_FOREACH (const Entry &entry, m_entries) {
+        out << entry.bssids << entry.cellKeys
+            << entry.position.latitude << entry.position.longitude << entry.position.accuracy
+            << entry.created << entry.lastUsed;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "unable to write online response cache" << m_fileName << ":" << file.errorString();
+        return false;
+    }
+
+    qDebug() << "saved" << m_entries.size() << "online responses to cache" << m_fileName;
+    m_dirty = false;
+    return true;
+}
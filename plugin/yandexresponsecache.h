@@ -0,0 +1,82 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef YANDEXRESPONSECACHE_H
+#define YANDEXRESPONSECACHE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+/*
+ * The YandexResponseCache class remembers the positions returned by the
+ * online service, keyed by the radio fingerprint of the query: the sorted
+ * BSSIDs of the visible access points and the sorted keys of the seen
+ * cells.  A query is answered from the cache if its fingerprint is known,
+ * or if its access points are similar enough (by Jaccard index) to those
+ * of a cached query.
+ *
+ * Entries expire after a while, the cache is size-capped with least
+ * recently used eviction, and it is persisted to disk.
+ */
+
+class YandexResponseCache
+{
+public:
+    struct Position {
+        double latitude;
+        double longitude;
+        double accuracy;
+    };
+
+    YandexResponseCache(const QString &fileName, int maximumSize, qint64 ttl, double similarityThreshold);
+    ~YandexResponseCache();
+
+    bool lookup(const QStringList &bssids, const QStringList &cellKeys, Position *position);
+    void insert(const QStringList &bssids, const QStringList &cellKeys, const Position &position);
+
+    int size() const { return m_entries.size(); }
+    bool isDirty() const { return m_dirty; }
+    bool save();
+
+    static QStringList normalisedBssids(const QStringList &bssids);
+
+private:
+    Q_DISABLE_COPY(YandexResponseCache)
+
+    struct Entry {
+        QStringList bssids;     // sorted
+        QStringList cellKeys;   // sorted
+        Position position;
+        qint64 created;
+        qint64 lastUsed;
+    };
+
+    static QString fingerprint(const QStringList &bssids, const QStringList &cellKeys);
+    void addEntry(quint32 id, const Entry &entry);
+    void removeEntry(quint32 id);
+    void evictLeastRecentlyUsed();
+    void loadIfNeeded();
+
+    QString m_fileName;
+    int m_maximumSize;
+    qint64 m_ttl;
+    double m_similarityThreshold;
+    QHash<quint32, Entry> m_entries;
+    QHash<QString, quint32> m_fingerprints;     // fingerprint -> entry
+    QHash<QString, QSet<quint32> > m_bssidIndex; // bssid -> entries containing it
+    quint32 m_nextId;
+    bool m_loaded;
+    bool m_dirty;
+};
+
+#endif // YANDEXRESPONSECACHE_H
@@ -10,6 +10,7 @@ Source1: %{name}.privileges
 BuildRequires: pkgconfig(Qt5Core)
 BuildRequires: pkgconfig(Qt5DBus)
 BuildRequires: pkgconfig(Qt5Network)
+BuildRequires: pkgconfig(Qt5Concurrent)
 BuildRequires: pkgconfig(qofono-qt5)
 BuildRequires: pkgconfig(qofonoext)
 BuildRequires: pkgconfig(connman-qt5)
@@ -20,6 +21,20 @@ Requires: mapplauncherd-qt5
 %description
 %{summary}.
 
+%package tools
+Summary: Tools for building the offline cell location database and testing the online locator
+Group: Development/Tools
+
+%description tools
+%{summary}.
+
+%package devel
+Summary: Header for reading the position feed of the Yandex geoclue provider
+Group: Development/Libraries
+
+%description devel
+%{summary}.
+
 
 %prep
 %setup -q -n %{name}-%{version}
@@ -42,3 +57,12 @@ install -m 644 -p %{SOURCE1} %{buildroot}%{_datadir}/mapplauncherd/privileges.d/
 %{_datadir}/mapplauncherd/privileges.d/*
 %{_datadir}/dbus-1/services/org.freedesktop.Geoclue.Providers.Yandex.service
 %{_datadir}/geoclue-providers/geoclue-yandex.provider
+
+%files tools
+%defattr(-,root,root,-)
+%{_bindir}/geoclue-mlsdb-build
+%{_bindir}/geoclue-yandex-mock-server
+
+%files devel
+%defattr(-,root,root,-)
+%{_includedir}/geoclue-yandex/yandexpositionfeed.h
@@ -0,0 +1,76 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QtDebug>
+
+#include "mlsdbbuilder.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("geoclue-mlsdb-build"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Builds the offline cell location database from a MLS or OpenCellID CSV export."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("input"), QStringLiteral("CSV cell export, or - for standard input."));
+    parser.addPositionalArgument(QStringLiteral("output"), QStringLiteral("Database directory to write the mlsdb.data files to."));
+    QCommandLineOption threadsOption(QStringLiteral("threads"),
+            QStringLiteral("Number of parser and writer threads."), QStringLiteral("count"));
+    QCommandLineOption chunkOption(QStringLiteral("chunk-lines"),
+            QStringLiteral("Number of input lines parsed per thread at a time."), QStringLiteral("lines"));
+    QCommandLineOption runOption(QStringLiteral("run-records"),
+            QStringLiteral("Number of records sorted in memory before spilling them to disk."), QStringLiteral("records"));
+    QCommandLineOption shardOption(QStringLiteral("shard-records"),
+            QStringLiteral("Approximate number of records per network shard."), QStringLiteral("records"));
+    QCommandLineOption legacyOption(QStringLiteral("legacy-buckets"),
+            QStringLiteral("Split the database by the first digit of the location code instead of per network."));
+    QCommandLineOption tmpOption(QStringLiteral("tmp"),
+            QStringLiteral("Directory for temporary run files."), QStringLiteral("path"));
+    parser.addOption(threadsOption);
+    parser.addOption(chunkOption);
+    parser.addOption(runOption);
+    parser.addOption(shardOption);
+    parser.addOption(legacyOption);
+    parser.addOption(tmpOption);
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 2) {
+        parser.showHelp(1);
+    }
+
+    MlsdbBuilder builder;
+    if (parser.isSet(threadsOption)) {
+        builder.setThreadCount(parser.value(threadsOption).toInt());
+    }
+    if (parser.isSet(chunkOption)) {
+        builder.setChunkLines(parser.value(chunkOption).toInt());
+    }
+    if (parser.isSet(runOption)) {
+        builder.setRunRecords(parser.value(runOption).toInt());
+    }
+    if (parser.isSet(shardOption)) {
+        builder.setShardRecords(parser.value(shardOption).toInt());
+    }
+    builder.setSharded(!parser.isSet(legacyOption));
+    if (parser.isSet(tmpOption)) {
+        builder.setTemporaryPath(parser.value(tmpOption));
+    }
+
+    if (!builder.build(arguments.at(0), arguments.at(1))) {
+        qWarning() << "Database build failed:" << builder.errorString();
+        return 1;
+    }
+    return 0;
+}
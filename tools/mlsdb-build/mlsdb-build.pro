@@ -0,0 +1,18 @@
+TARGET = geoclue-mlsdb-build
+CONFIG   += console
+CONFIG   -= app_bundle
+TEMPLATE = app
+
+target.path = /usr/bin
+
+QT = core concurrent
+
+include (../../common/common.pri)
+HEADERS += \
+    mlsdbbuilder.h
+
+SOURCES += \
+    main.cpp \
+    mlsdbbuilder.cpp
+
+INSTALLS += target
@@ -0,0 +1,604 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mlsdbbuilder.h"
+#include "mlsdbbloomfilter.h"
+#include "mlsdbshardmanifest.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFuture>
+#include <QtCore/QSaveFile>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QtDebug>
+#include <QtConcurrent/QtConcurrent>
+
+#include <QtCore/qmath.h>
+
+#include <algorithm>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+    const int DefaultChunkLines = 16384;
+    const int DefaultRunRecords = 4 * 1024 * 1024; // 80 MiB of records
+    const int DefaultShardRecords = 65536;          // 1.25 MiB per shard
+    const double MetresPerDegree = 111320.0;
+    const double MinimumAreaRadius = 1000.0;        // metres, a single cell covers at least this
+
+    void accumulateArea(QHash<quint64, MlsdbBuildArea> *locationCodes, const MlsdbBuildRecord &record)
+    {
+        const MlsdbUniqueCellId uniqueCellId = mlsdbIndexRecordCellId(record.data);
+        (*locationCodes)[MlsdbAreaTable::areaKey(MlsdbAreaTable::LocationCodeLevel, uniqueCellId)]
+                .add(uniqueCellId, mlsdbIndexRecordCoords(record.data));
+    }
+
+    struct RunPartition {
+        QString bucket;
+        QVector<MlsdbBuildRecord> records;
+    };
+
+    bool recordLessThan(const MlsdbBuildRecord &a, const MlsdbBuildRecord &b)
+    {
+        return memcmp(a.data, b.data, MLSDB_INDEX_KEY_SIZE) < 0;
+    }
+
+    void sortPartition(RunPartition &partition)
+    {
+        std::sort(partition.records.begin(), partition.records.end(), recordLessThan);
+    }
+
+    QString runFileName(const QString &bucket)
+    {
+        QString name(bucket);
+        return name.replace(QLatin1Char('/'), QLatin1Char('_'));
+    }
+
+    struct RunReader {
+        QFile file;
+        MlsdbBuildRecord record;
+
+        bool next()
+        {
+            return file.read(reinterpret_cast<char *>(record.data), MLSDB_INDEX_RECORD_SIZE) == MLSDB_INDEX_RECORD_SIZE;
+        }
+    };
+
+    // merges sorted run files into a single sorted stream of unique records.
+    class RunMerger
+    {
+    public:
+        RunMerger() : m_hasPrevious(false) {}
+
+        QString open(const QStringList &runs)
+        {
+            m_readers.clear();
+            m_hasPrevious = false;
+            Q_FOREACH (const QString &run, runs) {
+                QSharedPointer<RunReader> reader(new RunReader);
+                reader->file.setFileName(run);
+                if (!reader->file.open(QIODevice::ReadOnly)) {
+                    return QStringLiteral("Unable to read run file %1: %2").arg(run).arg(reader->file.errorString());
+                }
+                if (reader->next()) {
+                    m_readers.append(reader);
+                }
+            }
+            return QString();
+        }
+
+        bool next(MlsdbBuildRecord *record)
+        {
+            while (!m_readers.isEmpty()) {
+                int smallest = 0;
+                for (int i = 1; i < m_readers.size(); ++i) {
+                    if (recordLessThan(m_readers.at(i)->record, m_readers.at(smallest)->record)) {
+                        smallest = i;
+                    }
+                }
+
+                *record = m_readers.at(smallest)->record;
+                if (!m_readers.at(smallest)->next()) {
+                    m_readers.removeAt(smallest);
+                }
+                if (!m_hasPrevious || memcmp(m_previous.data, record->data, MLSDB_INDEX_KEY_SIZE) != 0) {
+                    m_previous = *record;
+                    m_hasPrevious = true;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        QList<QSharedPointer<RunReader> > m_readers;
+        MlsdbBuildRecord m_previous;
+        bool m_hasPrevious;
+    };
+
+    // writes a version 4 data file and its bloom filter.  the filter is sized for
+    // the expected record count up front and filled as the records are written,
+    // the exact count is only known once the file is complete.
+    class DataFileWriter
+    {
+    public:
+        DataFileWriter() : m_count(0) {}
+
+        QString open(const QString &dataPath, quint32 expectedCount)
+        {
+            m_filter.reset(expectedCount);
+            if (!QDir().mkpath(dataPath)) {
+                return QStringLiteral("Unable to create directory %1").arg(dataPath);
+            }
+            m_dataPath = dataPath;
+            m_file.reset(new QSaveFile(dataPath + QStringLiteral("/mlsdb.data")));
+            if (!m_file->open(QIODevice::WriteOnly)) {
+                return QStringLiteral("Unable to write %1: %2").arg(m_file->fileName()).arg(m_file->errorString());
+            }
+            uchar header[MLSDB_INDEX_HEADER_SIZE];
+            mlsdbIndexHeader(0, header);
+            m_file->write(reinterpret_cast<const char *>(header), MLSDB_INDEX_HEADER_SIZE);
+            return QString();
+        }
+
+        void write(const MlsdbBuildRecord &record)
+        {
+            m_file->write(reinterpret_cast<const char *>(record.data), MLSDB_INDEX_RECORD_SIZE);
+            m_filter.insert(mlsdbIndexRecordCellId(record.data));
+            ++m_count;
+        }
+
+        QString commit()
+        {
+            // a filter which doesn't match its data file would reject cells the data
+            // file holds, while a missing one only costs a search.  so the old filter
+            // is removed before the data file is replaced, and the new one written after.
+            const QString filterFileName = m_dataPath + QStringLiteral("/" MLSDB_BLOOM_FILE_NAME);
+            if (QFile::exists(filterFileName) && !QFile::remove(filterFileName)) {
+                m_file->cancelWriting();
+                m_file->commit();
+                return QStringLiteral("Unable to remove %1").arg(filterFileName);
+            }
+
+            uchar header[MLSDB_INDEX_HEADER_SIZE];
+            mlsdbIndexHeader(m_count, header);
+            if (!m_file->seek(0)
+                    || m_file->write(reinterpret_cast<const char *>(header), MLSDB_INDEX_HEADER_SIZE) != MLSDB_INDEX_HEADER_SIZE) {
+                m_file->cancelWriting();
+            }
+            if (!m_file->commit()) {
+                return QStringLiteral("Unable to write %1: %2").arg(m_file->fileName()).arg(m_file->errorString());
+            }
+            qInfo() << "wrote" << m_count << "cell locations to" << m_file->fileName();
+
+            if (!m_filter.save(filterFileName)) {
+                return QStringLiteral("Unable to write %1").arg(filterFileName);
+            }
+            return QString();
+        }
+
+        quint32 count() const { return m_count; }
+
+    private:
+        QString m_dataPath;
+        QScopedPointer<QSaveFile> m_file;
+        MlsdbBloomFilter m_filter;
+        quint32 m_count;
+    };
+}
+
+MlsdbBuildArea::MlsdbBuildArea()
+    : sumLat(0.0)
+    , sumLon(0.0)
+    , sumLatSquared(0.0)
+    , sumLonSquared(0.0)
+    , count(0)
+{
+}
+
+void MlsdbBuildArea::add(const MlsdbUniqueCellId &uniqueCellId, const MlsdbCoords &coords)
+{
+    cellId = uniqueCellId;
+    sumLat += coords.lat;
+    sumLon += coords.lon;
+    sumLatSquared += coords.lat * coords.lat;
+    sumLonSquared += coords.lon * coords.lon;
+    ++count;
+}
+
+void MlsdbBuildArea::add(const MlsdbBuildArea &other)
+{
+    cellId = other.cellId;
+    sumLat += other.sumLat;
+    sumLon += other.sumLon;
+    sumLatSquared += other.sumLatSquared;
+    sumLonSquared += other.sumLonSquared;
+    count += other.count;
+}
+
+MlsdbAreaLocation MlsdbBuildArea::location() const
+{
+    // the radius is twice the root mean square distance of the cells from the
+    // centroid, in a local flat approximation.  areas spanning the antimeridian
+    // get a meaningless centroid, which is acceptable for a coarse fallback.
+    MlsdbAreaLocation location;
+    if (count == 0) {
+        return location;
+    }
+    location.coords.lat = sumLat / count;
+    location.coords.lon = sumLon / count;
+    location.cellCount = count;
+    const double latVariance = qMax(0.0, sumLatSquared / count - location.coords.lat * location.coords.lat);
+    const double lonVariance = qMax(0.0, sumLonSquared / count - location.coords.lon * location.coords.lon);
+    const double dy = qSqrt(latVariance) * MetresPerDegree;
+    const double dx = qSqrt(lonVariance) * MetresPerDegree * qCos(qDegreesToRadians(location.coords.lat));
+    location.radius = quint32(qMax(MinimumAreaRadius, 2.0 * qSqrt(dx * dx + dy * dy)));
+    return location;
+}
+
+MlsdbBuilder::MlsdbBuilder()
+    : m_threadCount(QThread::idealThreadCount())
+    , m_chunkLines(DefaultChunkLines)
+    , m_runRecords(DefaultRunRecords)
+    , m_shardRecords(DefaultShardRecords)
+    , m_sharded(true)
+    , m_runCount(0)
+    , m_parsedLines(0)
+    , m_acceptedRecords(0)
+{
+}
+
+void MlsdbBuilder::setThreadCount(int threadCount)
+{
+    m_threadCount = qMax(1, threadCount);
+}
+
+void MlsdbBuilder::setChunkLines(int chunkLines)
+{
+    m_chunkLines = qMax(1, chunkLines);
+}
+
+void MlsdbBuilder::setRunRecords(int runRecords)
+{
+    m_runRecords = qMax(1, runRecords);
+}
+
+void MlsdbBuilder::setShardRecords(int shardRecords)
+{
+    m_shardRecords = qMax(1, shardRecords);
+}
+
+void MlsdbBuilder::setSharded(bool sharded)
+{
+    m_sharded = sharded;
+}
+
+void MlsdbBuilder::setTemporaryPath(const QString &path)
+{
+    m_temporaryPath = path;
+}
+
+QVector<MlsdbBuildRecord> MlsdbBuilder::parseChunk(const QList<QByteArray> &lines)
+{
+    // radio,mcc,net,area,cell,unit,lon,lat,range,samples,changeable,created,updated,averageSignal
+    QVector<MlsdbBuildRecord> records;
+    records.reserve(lines.size());
+    Q_FOREACH (const QByteArray &line, lines) {
+        const QList<QByteArray> fields = line.trimmed().split(',');
+        if (fields.size() < 8) {
+            continue;
+        }
+
+        MlsdbCellType cellType;
+        const QByteArray radio = fields.at(0).toUpper();
+        if (radio == "LTE") {
+            cellType = MLSDB_CELL_TYPE_LTE;
+        } else if (radio == "GSM") {
+            cellType = MLSDB_CELL_TYPE_GSM;
+        } else if (radio == "UMTS") {
+            cellType = MLSDB_CELL_TYPE_UMTS;
+        } else {
+            continue; // the header line, or a radio type the provider doesn't report
+        }
+
+        bool mccOk = false, mncOk = false, areaOk = false, cellOk = false, lonOk = false, latOk = false;
+        const quint32 mcc = fields.at(1).toUInt(&mccOk);
+        const quint32 mnc = fields.at(2).toUInt(&mncOk);
+        const quint32 area = fields.at(3).toUInt(&areaOk);
+        const quint32 cell = fields.at(4).toUInt(&cellOk);
+        MlsdbCoords coords;
+        coords.lon = fields.at(6).toDouble(&lonOk);
+        coords.lat = fields.at(7).toDouble(&latOk);
+        if (!mccOk || !mncOk || !areaOk || !cellOk || !lonOk || !latOk
+                || mcc == 0 || mcc > 0xFFFF || mnc > 0xFFFF
+                || cell == 0 || cell > 0x0FFFFFFF) {
+            continue;
+        }
+
+        MlsdbBuildRecord record;
+        mlsdbIndexRecord(MlsdbUniqueCellId(cellType, cell, area, mcc, mnc), coords, record.data);
+        records.append(record);
+    }
+    return records;
+}
+
+void MlsdbBuilder::parseChunks(QList<QList<QByteArray> > *chunks)
+{
+    const QList<QVector<MlsdbBuildRecord> > parsed
+            = QtConcurrent::blockingMapped<QList<QVector<MlsdbBuildRecord> > >(*chunks, &MlsdbBuilder::parseChunk);
+    chunks->clear();
+    Q_FOREACH (const QVector<MlsdbBuildRecord> &records, parsed) {
+        m_run += records;
+        m_acceptedRecords += records.size();
+    }
+}
+
+bool MlsdbBuilder::spillRun()
+{
+    if (m_run.isEmpty()) {
+        return true;
+    }
+
+    // partition the run buffer by network or bucket, and sort the partitions in parallel.
+    QHash<QString, int> partitionIndexes;
+    QList<RunPartition> partitions;
+    Q_FOREACH (const MlsdbBuildRecord &record, m_run) {
+        const MlsdbUniqueCellId uniqueCellId = mlsdbIndexRecordCellId(record.data);
+        const QString bucket = m_sharded ? QStringLiteral("%1/%2").arg(uniqueCellId.mcc()).arg(uniqueCellId.mnc())
+                                         : mlsdbBucketForCellId(uniqueCellId);
+        QHash<QString, int>::const_iterator it = partitionIndexes.constFind(bucket);
+        int index;
+        if (it == partitionIndexes.constEnd()) {
+            index = partitions.size();
+            partitionIndexes.insert(bucket, index);
+            partitions.append(RunPartition());
+            partitions.last().bucket = bucket;
+        } else {
+            index = it.value();
+        }
+        partitions[index].records.append(record);
+    }
+    m_run.clear();
+
+    QtConcurrent::blockingMap(partitions, sortPartition);
+
+    Q_FOREACH (const RunPartition &partition, partitions) {
+        const QString fileName = QStringLiteral("%1/%2-%3.run").arg(m_runPath).arg(runFileName(partition.bucket)).arg(m_runCount);
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            m_errorString = QStringLiteral("Unable to write run file %1: %2").arg(fileName).arg(file.errorString());
+            return false;
+        }
+        const qint64 size = qint64(partition.records.size()) * MLSDB_INDEX_RECORD_SIZE;
+        if (file.write(reinterpret_cast<const char *>(partition.records.constData()), size) != size) {
+            m_errorString = QStringLiteral("Unable to write run file %1: %2").arg(fileName).arg(file.errorString());
+            return false;
+        }
+        m_partitionRuns[partition.bucket].append(fileName);
+    }
+
+    ++m_runCount;
+    qInfo() << "spilled run" << m_runCount << "after" << m_parsedLines << "lines," << m_acceptedRecords << "records";
+    return true;
+}
+
+MlsdbBuilder::MergeResult MlsdbBuilder::mergePartition(const QString &partition, const QString &outputPath) const
+{
+    MergeResult result;
+    result.partition = partition;
+    const QStringList runs = m_partitionRuns.value(partition);
+    RunMerger merger;
+    MlsdbBuildRecord record;
+
+    if (!m_sharded) {
+        // the runs may still hold duplicates, their size is an upper bound of the record count.
+        quint64 runRecords = 0;
+        Q_FOREACH (const QString &run, runs) {
+            runRecords += QFileInfo(run).size() / MLSDB_INDEX_RECORD_SIZE;
+        }
+        DataFileWriter writer;
+        result.error = merger.open(runs);
+        if (result.error.isEmpty()) {
+            result.error = writer.open(QStringLiteral("%1/%2").arg(outputPath).arg(partition),
+                                       quint32(qMin<quint64>(runRecords, UINT_MAX)));
+        }
+        if (!result.error.isEmpty()) {
+            return result;
+        }
+        while (merger.next(&record)) {
+            writer.write(record);
+            accumulateArea(&result.locationCodes, record);
+        }
+        result.error = writer.commit();
+    } else {
+        // count the cells per location code first, so that the network can be split
+        // into shards of roughly the requested size.
+        QHash<quint32, quint32> locationCodeCounts;
+        quint32 total = 0;
+        result.error = merger.open(runs);
+        if (!result.error.isEmpty()) {
+            return result;
+        }
+        while (merger.next(&record)) {
+            const MlsdbUniqueCellId uniqueCellId = mlsdbIndexRecordCellId(record.data);
+            result.mcc = uniqueCellId.mcc();
+            result.mnc = uniqueCellId.mnc();
+            locationCodeCounts[uniqueCellId.locationCode()] += 1;
+            ++total;
+        }
+
+        // a shard holds at least one location code, more shards than that can't be balanced.
+        const quint32 shardCount = qBound<quint32>(1, (total + m_shardRecords - 1) / m_shardRecords,
+                                                   locationCodeCounts.size());
+        QVector<quint32> shardCounts(shardCount, 0);
+        for (QHash<quint32, quint32>::const_iterator it = locationCodeCounts.constBegin();
+                it != locationCodeCounts.constEnd(); ++it) {
+            shardCounts[MlsdbShardManifest::shardIndex(it.key(), shardCount)] += it.value();
+        }
+        QVector<QSharedPointer<DataFileWriter> > writers(shardCount);
+        for (quint32 i = 0; i < shardCount; ++i) {
+            writers[i] = QSharedPointer<DataFileWriter>(new DataFileWriter);
+            result.error = writers[i]->open(QStringLiteral("%1/%2").arg(outputPath)
+                    .arg(MlsdbShardManifest::shardName(result.mcc, result.mnc, i)), shardCounts.at(i));
+            if (!result.error.isEmpty()) {
+                return result;
+            }
+        }
+
+        result.error = merger.open(runs);
+        if (!result.error.isEmpty()) {
+            return result;
+        }
+        while (merger.next(&record)) {
+            const quint32 locationCode = mlsdbIndexRecordCellId(record.data).locationCode();
+            writers[MlsdbShardManifest::shardIndex(locationCode, shardCount)]->write(record);
+            accumulateArea(&result.locationCodes, record);
+        }
+
+        result.shardSizes.resize(shardCount);
+        for (quint32 i = 0; i < shardCount && result.error.isEmpty(); ++i) {
+            result.error = writers[i]->commit();
+            result.shardSizes[i] = writers[i]->count();
+        }
+    }
+
+    if (result.error.isEmpty()) {
+        Q_FOREACH (const QString &run, runs) {
+            QFile::remove(run);
+        }
+    }
+    return result;
+}
+
+bool MlsdbBuilder::writeAreaTable(const QList<MergeResult> &results, const QString &outputPath)
+{
+    // networks and countries are rolled up from their location areas, which
+    // may have been spread over several partitions in the legacy layout.
+    QHash<quint64, MlsdbBuildArea> areas[MlsdbAreaTable::LevelCount];
+    Q_FOREACH (const MergeResult &result, results) {
+        QHash<quint64, MlsdbBuildArea>::const_iterator it = result.locationCodes.constBegin();
+        for (; it != result.locationCodes.constEnd(); ++it) {
+            areas[MlsdbAreaTable::LocationCodeLevel][it.key()].add(it.value());
+            areas[MlsdbAreaTable::NetworkLevel][MlsdbAreaTable::areaKey(MlsdbAreaTable::NetworkLevel, it.value().cellId)].add(it.value());
+            areas[MlsdbAreaTable::CountryLevel][MlsdbAreaTable::areaKey(MlsdbAreaTable::CountryLevel, it.value().cellId)].add(it.value());
+        }
+    }
+
+    MlsdbAreaTable table;
+    for (int level = 0; level < MlsdbAreaTable::LevelCount; ++level) {
+        QHash<quint64, MlsdbBuildArea>::const_iterator it = areas[level].constBegin();
+        for (; it != areas[level].constEnd(); ++it) {
+            table.insert(static_cast<MlsdbAreaTable::Level>(level), it.key(), it.value().location());
+        }
+    }
+
+    const QString fileName = QStringLiteral("%1/%2").arg(outputPath).arg(QStringLiteral(MLSDB_AREAS_FILE_NAME));
+    if (!table.save(fileName)) {
+        m_errorString = QStringLiteral("Unable to write %1").arg(fileName);
+        return false;
+    }
+    qInfo() << "wrote" << areas[MlsdbAreaTable::LocationCodeLevel].size() << "location areas,"
+            << areas[MlsdbAreaTable::NetworkLevel].size() << "networks and"
+            << areas[MlsdbAreaTable::CountryLevel].size() << "countries to" << fileName;
+    return true;
+}
+
+bool MlsdbBuilder::build(const QString &inputFileName, const QString &outputPath)
+{
+    QFile input;
+    if (inputFileName == QStringLiteral("-")) {
+        if (!input.open(stdin, QIODevice::ReadOnly)) {
+            m_errorString = QStringLiteral("Unable to read standard input: %1").arg(input.errorString());
+            return false;
+        }
+    } else {
+        input.setFileName(inputFileName);
+        if (!input.open(QIODevice::ReadOnly)) {
+            m_errorString = QStringLiteral("Unable to read %1: %2").arg(inputFileName).arg(input.errorString());
+            return false;
+        }
+    }
+
+    QTemporaryDir runDir((m_temporaryPath.isEmpty() ? QDir::tempPath() : m_temporaryPath)
+                         + QStringLiteral("/mlsdb-build-XXXXXX"));
+    if (!runDir.isValid()) {
+        m_errorString = QStringLiteral("Unable to create a temporary directory");
+        return false;
+    }
+    m_runPath = runDir.path();
+    QThreadPool::globalInstance()->setMaxThreadCount(m_threadCount);
+
+    // read the input a batch of chunks at a time, one chunk per thread.
+    QList<QList<QByteArray> > chunks;
+    QList<QByteArray> chunk;
+    for (;;) {
+        const QByteArray line = input.readLine();
+        if (!line.isEmpty()) {
+            chunk.append(line);
+            ++m_parsedLines;
+        }
+        const bool atEnd = line.isEmpty();
+        if (chunk.size() >= m_chunkLines || (atEnd && !chunk.isEmpty())) {
+            chunks.append(chunk);
+            chunk.clear();
+        }
+        if (chunks.size() >= m_threadCount || (atEnd && !chunks.isEmpty())) {
+            parseChunks(&chunks);
+            if (m_run.size() >= m_runRecords && !spillRun()) {
+                return false;
+            }
+        }
+        if (atEnd) {
+            break;
+        }
+    }
+    if (!spillRun()) {
+        return false;
+    }
+
+    QList<QFuture<MergeResult> > merges;
+    Q_FOREACH (const QString &partition, m_partitionRuns.keys()) {
+        merges.append(QtConcurrent::run(this, &MlsdbBuilder::mergePartition, partition, outputPath));
+    }
+    MlsdbShardManifest manifest;
+    QList<MergeResult> results;
+    Q_FOREACH (QFuture<MergeResult> merge, merges) {
+        const MergeResult result = merge.result();
+        results.append(result);
+        if (!result.error.isEmpty()) {
+            m_errorString = result.error;
+        } else if (m_sharded) {
+            manifest.setShardSizes(result.mcc, result.mnc, result.shardSizes);
+            qInfo() << "network" << result.partition << "split into" << result.shardSizes.size() << "shards:" << result.shardSizes;
+        }
+    }
+
+    const QString manifestFileName = QStringLiteral("%1/%2").arg(outputPath).arg(QStringLiteral(MLSDB_MANIFEST_FILE_NAME));
+    if (m_sharded && m_errorString.isEmpty() && !manifest.save(manifestFileName)) {
+        m_errorString = QStringLiteral("Unable to write %1").arg(manifestFileName);
+    } else if (!m_sharded && QFile::exists(manifestFileName)) {
+        // a stale manifest would hide the legacy buckets from the provider.
+        QFile::remove(manifestFileName);
+    }
+    if (m_errorString.isEmpty()) {
+        writeAreaTable(results, outputPath);
+    }
+
+    qInfo() << "read" << m_parsedLines << "lines," << m_acceptedRecords << "records in"
+            << m_partitionRuns.size() << (m_sharded ? "networks" : "buckets");
+    return m_errorString.isEmpty();
+}
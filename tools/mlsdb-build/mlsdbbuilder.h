@@ -0,0 +1,108 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef MLSDBBUILDER_H
+#define MLSDBBUILDER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+#include "mlsdbindexfile.h"
+#include "mlsdbareatable.h"
+
+/*
+ * The MlsdbBuilder class converts a Mozilla Location Service or
+ * OpenCellID CSV cell export into version 4 mlsdb.data files.
+ *
+ * The input is streamed in chunks which are parsed in parallel.  Parsed
+ * records are collected into a bounded run buffer, which is sorted and
+ * spilled to per-network run files whenever it fills up.  Finally the runs
+ * of every network are merged and split by location code hash into shards
+ * of roughly equal size, which are listed in the database's shard manifest.
+ * The legacy "first digit of location code" buckets can be built instead.
+ *
+ * While merging, the centroids of every location area, network and country
+ * are accumulated, and written to the database's area table.
+ */
+
+struct MlsdbBuildRecord {
+    uchar data[MLSDB_INDEX_RECORD_SIZE];
+};
+Q_DECLARE_TYPEINFO(MlsdbBuildRecord, Q_PRIMITIVE_TYPE);
+
+struct MlsdbBuildArea {
+    MlsdbBuildArea();
+
+    void add(const MlsdbUniqueCellId &uniqueCellId, const MlsdbCoords &coords);
+    void add(const MlsdbBuildArea &other);
+    MlsdbAreaLocation location() const;
+
+    MlsdbUniqueCellId cellId; // any cell of the area
+    double sumLat;
+    double sumLon;
+    double sumLatSquared;
+    double sumLonSquared;
+    quint32 count;
+};
+
+class MlsdbBuilder
+{
+public:
+    MlsdbBuilder();
+
+    void setThreadCount(int threadCount);
+    void setChunkLines(int chunkLines);
+    void setRunRecords(int runRecords);
+    void setShardRecords(int shardRecords);
+    void setSharded(bool sharded);
+    void setTemporaryPath(const QString &path);
+
+    bool build(const QString &inputFileName, const QString &outputPath);
+    QString errorString() const { return m_errorString; }
+
+private:
+    struct MergeResult {
+        MergeResult() : mcc(0), mnc(0) {}
+        QString partition;
+        QString error;
+        quint16 mcc;
+        quint16 mnc;
+        QVector<quint32> shardSizes;
+        QHash<quint64, MlsdbBuildArea> locationCodes;
+    };
+
+    static QVector<MlsdbBuildRecord> parseChunk(const QList<QByteArray> &lines);
+    void parseChunks(QList<QList<QByteArray> > *chunks);
+    bool spillRun();
+    MergeResult mergePartition(const QString &partition, const QString &outputPath) const;
+    bool writeAreaTable(const QList<MergeResult> &results, const QString &outputPath);
+
+    int m_threadCount;
+    int m_chunkLines;
+    int m_runRecords;
+    int m_shardRecords;
+    bool m_sharded;
+    QString m_temporaryPath;
+    QString m_runPath;
+    QString m_errorString;
+
+    QVector<MlsdbBuildRecord> m_run;
+    QHash<QString, QStringList> m_partitionRuns;
+    int m_runCount;
+    quint64 m_parsedLines;
+    quint64 m_acceptedRecords;
+};
+
+#endif // MLSDBBUILDER_H
@@ -0,0 +1,55 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QtDebug>
+#include <QtNetwork/QHostAddress>
+
+#include "mockserver.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("geoclue-yandex-mock-server"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Stands in for the Yandex geolocation service, replaying scripted responses."));
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringLiteral("port"),
+            QStringLiteral("Port to listen on, 8080 by default."), QStringLiteral("port"), QStringLiteral("8080"));
+    QCommandLineOption scriptOption(QStringLiteral("script"),
+            QStringLiteral("JSON script of the responses to replay, a single fixed position by default."), QStringLiteral("file"));
+    QCommandLineOption logOption(QStringLiteral("log-requests"),
+            QStringLiteral("Print the body of every request, so that it can be recorded."));
+    parser.addOption(portOption);
+    parser.addOption(scriptOption);
+    parser.addOption(logOption);
+    parser.process(app);
+
+    MockServer server;
+    if (parser.isSet(scriptOption)) {
+        QString errorString;
+        if (!server.loadScript(parser.value(scriptOption), &errorString)) {
+            qWarning() << errorString;
+            return 1;
+        }
+    } else {
+        server.setDefaultScript();
+    }
+    server.setLogRequests(parser.isSet(logOption));
+
+    if (!server.listen(QHostAddress::LocalHost, parser.value(portOption).toUShort())) {
+        qWarning() << "Unable to listen:" << server.errorString();
+        return 1;
+    }
+    return app.exec();
+}
@@ -0,0 +1,204 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#include "mockserver.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QPointer>
+#include <QtCore/QTimer>
+#include <QtCore/QtDebug>
+#include <QtNetwork/QTcpSocket>
+
+namespace {
+    const QByteArray HeaderTerminator("\r\n\r\n");
+
+    QByteArray reasonPhrase(int status)
+    {
+        switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+        }
+    }
+}
+
+MockServer::MockServer(QObject *parent)
+    : QObject(parent)
+    , m_loop(true)
+    , m_logRequests(false)
+    , m_nextStep(0)
+    , m_requestCount(0)
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &MockServer::newConnection);
+}
+
+bool MockServer::loadScript(const QString &fileName, QString *errorString)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorString = QStringLiteral("Unable to read %1: %2").arg(fileName).arg(file.errorString());
+        return false;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+        *errorString = QStringLiteral("Unable to parse %1: %2").arg(fileName).arg(parseError.errorString());
+        return false;
+    }
+
+    const QDir scriptDir = QFileInfo(fileName).absoluteDir();
+    const QJsonObject script = document.object();
+    m_loop = script.value(QStringLiteral("loop")).toBool(true);
+    m_steps.clear();
+    Q_FOREACH (const QJsonValue &value, script.value(QStringLiteral("steps")).toArray()) {
+        const QJsonObject object = value.toObject();
+        Step step;
+        step.status = object.value(QStringLiteral("status")).toInt(200);
+        step.delay = object.value(QStringLiteral("delay")).toInt(0);
+        step.timeout = object.value(QStringLiteral("timeout")).toBool(false);
+        step.close = object.value(QStringLiteral("close")).toBool(false);
+        if (object.contains(QStringLiteral("bodyFile"))) {
+            QFile bodyFile(scriptDir.filePath(object.value(QStringLiteral("bodyFile")).toString()));
+            if (!bodyFile.open(QIODevice::ReadOnly)) {
+                *errorString = QStringLiteral("Unable to read %1: %2").arg(bodyFile.fileName()).arg(bodyFile.errorString());
+                return false;
+            }
+            step.body = bodyFile.readAll();
+        } else if (object.value(QStringLiteral("body")).isObject()) {
+            step.body = QJsonDocument(object.value(QStringLiteral("body")).toObject()).toJson(QJsonDocument::Compact);
+        } else {
+            step.body = object.value(QStringLiteral("body")).toString().toUtf8();
+        }
+        m_steps.append(step);
+    }
+
+    if (m_steps.isEmpty()) {
+        *errorString = QStringLiteral("Script %1 has no steps").arg(fileName);
+        return false;
+    }
+    return true;
+}
+
+void MockServer::setDefaultScript()
+{
+    Step step;
+    step.body = "{\"position\":{\"latitude\":55.7539,\"longitude\":37.6208,"
+                "\"altitude\":0.0,\"precision\":100.0,\"altitude_precision\":30.0,\"type\":\"wifi\"}}";
+    m_steps.clear();
+    m_steps.append(step);
+    m_loop = true;
+}
+
+bool MockServer::listen(const QHostAddress &address, quint16 port)
+{
+    if (!m_server.listen(address, port)) {
+        return false;
+    }
+    qInfo() << "listening on" << m_server.serverAddress().toString() << m_server.serverPort()
+            << "with" << m_steps.size() << "scripted steps";
+    return true;
+}
+
+void MockServer::newConnection()
+{
+    while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+        m_requests.insert(socket, Request());
+        connect(socket, &QTcpSocket::readyRead, this, &MockServer::readRequest);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_requests.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MockServer::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket || !m_requests.contains(socket)) {
+        return;
+    }
+
+    Request &request(m_requests[socket]);
+    if (request.data.isEmpty()) {
+        request.received.start(); // the first bytes of a new request
+    }
+    request.data += socket->readAll();
+    const int headerEnd = request.data.indexOf(HeaderTerminator);
+    if (headerEnd < 0) {
+        return;
+    }
+    if (request.contentLength < 0) {
+        request.contentLength = 0;
+        Q_FOREACH (const QByteArray &line, request.data.left(headerEnd).split('\n')) {
+            if (line.toLower().startsWith("content-length:")) {
+                request.contentLength = line.mid(15).trimmed().toInt();
+            }
+        }
+    }
+    if (request.data.size() < headerEnd + HeaderTerminator.size() + request.contentLength) {
+        return;
+    }
+
+    // a complete request, answer it with the next step of the script.
+    if (m_nextStep >= m_steps.size()) {
+        m_nextStep = m_loop ? 0 : m_steps.size() - 1;
+    }
+    const int index = m_nextStep++;
+    ++m_requestCount;
+    if (m_logRequests) {
+        qInfo().noquote() << request.data.mid(headerEnd + HeaderTerminator.size());
+    }
+    respond(socket, m_steps.at(index), index, request.received);
+    request.data.clear();
+    request.contentLength = -1;
+}
+
+void MockServer::respond(QTcpSocket *socket, const Step &step, int index, const QElapsedTimer &received)
+{
+    const int requestNumber = m_requestCount;
+    if (step.timeout) {
+        qInfo() << "request" << requestNumber << "step" << index << ": not answering";
+        return;
+    }
+
+    QPointer<QTcpSocket> guard(socket);
+    QTimer::singleShot(step.delay, this, [guard, step, index, received, requestNumber]() {
+        if (!guard) {
+            qInfo() << "request" << requestNumber << "step" << index << ": client went away";
+            return;
+        }
+        if (step.close) {
+            qInfo() << "request" << requestNumber << "step" << index << ": closing connection";
+            guard->abort();
+            return;
+        }
+        QByteArray response = "HTTP/1.1 " + QByteArray::number(step.status) + ' ' + reasonPhrase(step.status) + "\r\n";
+        response += "Content-Type: application/json\r\n";
+        response += "Content-Length: " + QByteArray::number(step.body.size()) + "\r\n";
+        response += "Connection: close\r\n\r\n";
+        response += step.body;
+        guard->write(response);
+        guard->disconnectFromHost();
+        qInfo() << "request" << requestNumber << "step" << index << ": status" << step.status
+                << "after" << received.elapsed() << "ms";
+    });
+}
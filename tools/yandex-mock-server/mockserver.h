@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2026 Chupligin Sergey <neochapay@gmail.com>
+
+    This file is part of geoclue-yandex based on geoclue-mlsdb.
+
+    Geoclue-yandex is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License.
+*/
+
+#ifndef MOCKSERVER_H
+#define MOCKSERVER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtNetwork/QTcpServer>
+
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+
+/*
+ * The MockServer class stands in for the Yandex geolocation service.
+ * Every POST request is answered by the next step of a script, which
+ * replays a recorded response after a scripted delay, or simulates a
+ * timeout (the request is never answered) or a dropped connection.
+ *
+ * Script format (JSON):
+ *   { "loop": true,
+ *     "steps": [ { "status": 200, "delay": 150, "body": { ... } },
+ *                { "status": 400, "bodyFile": "keyfailure.json" },
+ *                { "timeout": true },
+ *                { "close": true, "delay": 50 } ] }
+ */
+
+class MockServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Step {
+        Step() : status(200), delay(0), timeout(false), close(false) {}
+        int status;
+        int delay;          // msecs before the response is sent
+        bool timeout;       // never answer
+        bool close;         // close the connection without answering
+        QByteArray body;
+    };
+
+    explicit MockServer(QObject *parent = 0);
+
+    bool loadScript(const QString &fileName, QString *errorString);
+    void setDefaultScript();
+    void setLogRequests(bool log) { m_logRequests = log; }
+    bool listen(const QHostAddress &address, quint16 port);
+    QString errorString() const { return m_server.errorString(); }
+
+private Q_SLOTS:
+    void newConnection();
+    void readRequest();
+
+private:
+    struct Request {
+        Request() : contentLength(-1) {}
+        QByteArray data;
+        int contentLength;
+        QElapsedTimer received;
+    };
+
+    void respond(QTcpSocket *socket, const Step &step, int index, const QElapsedTimer &received);
+
+    QTcpServer m_server;
+    QList<Step> m_steps;
+    bool m_loop;
+    bool m_logRequests;
+    int m_nextStep;
+    int m_requestCount;
+    QHash<QTcpSocket *, Request> m_requests;
+};
+
+#endif // MOCKSERVER_H
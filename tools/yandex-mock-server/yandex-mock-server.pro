@@ -0,0 +1,20 @@
+TARGET = geoclue-yandex-mock-server
+CONFIG   += console
+CONFIG   -= app_bundle
+TEMPLATE = app
+
+target.path = /usr/bin
+
+QT = core network
+
+HEADERS += \
+    mockserver.h
+
+SOURCES += \
+    main.cpp \
+    mockserver.cpp
+
+OTHER_FILES = \
+    example-script.json
+
+INSTALLS += target